@@ -0,0 +1,134 @@
+/*
+* @file EventCapture.c
+*
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _DEFAULT_SOURCE
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+#include "EventCapture.h"
+
+#ifdef _WIN32
+
+bool eventCaptureOpen(EventCapture* capture, const char* path)
+{
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+    void* data;
+
+    memset(capture, 0, sizeof(*capture));
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart == 0)
+    {
+        capture->file = file;
+        return true;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    capture->data = data;
+    capture->size = (size_t)size.QuadPart;
+    capture->mapping = mapping;
+    capture->file = file;
+    return true;
+}
+
+void eventCaptureClose(EventCapture* capture)
+{
+    if (capture->data)
+    {
+        UnmapViewOfFile(capture->data);
+    }
+    if (capture->mapping)
+    {
+        CloseHandle(capture->mapping);
+    }
+    if (capture->file)
+    {
+        CloseHandle(capture->file);
+    }
+    memset(capture, 0, sizeof(*capture));
+}
+
+#else
+
+bool eventCaptureOpen(EventCapture* capture, const char* path)
+{
+    struct stat st;
+    void* data;
+    int fd;
+
+    memset(capture, 0, sizeof(*capture));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    // Scans read the capture front to back once.
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    capture->data = data;
+    capture->size = (size_t)st.st_size;
+    capture->mapping = data;
+    return true;
+}
+
+void eventCaptureClose(EventCapture* capture)
+{
+    if (capture->mapping)
+    {
+        munmap(capture->mapping, capture->size);
+    }
+    memset(capture, 0, sizeof(*capture));
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "EventLog.h"
+
+// An EventLog capture file mapped read-only into memory, for offline
+// scans with eventFrameIterInit() / eventFrameNext().
+//
+// For example,
+// EventCapture cap;
+// EventFrameIter iter;
+// EventFrameView view;
+// if (eventCaptureOpen(&cap, "board1.bin")) {
+//     eventFrameIterInit(&iter, cap.data, cap.size);
+//     while (eventFrameNext(&iter, &view))
+//         if (eventFrameLevel(&view) == EVENT_ERROR) errors++;
+//     eventCaptureClose(&cap);
+// }
+
+typedef struct EventCapture
+{
+	const char* data;
+	size_t size;
+
+	// Private
+	void* mapping;
+	void* file;
+} EventCapture;
+
+// Maps a capture file.  Returns false if it can't be opened or mapped.
+// An empty file opens successfully with size 0.
+bool eventCaptureOpen(EventCapture* capture, const char* path);
+
+void eventCaptureClose(EventCapture* capture);
@@ -0,0 +1,205 @@
+/*
+* @file EventClock.c
+*
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+#include "EventLog.h"
+#include "EventClock.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HAVE_TSC 1
+#endif
+
+// Counter ticks are turned into microseconds as (ticks * itsMult) >> 32.
+#define CALIBRATION_NS 20000000
+
+static bool itsUseTsc;
+static uint64_t itsBase;
+static uint64_t itsMult;
+// Monotonic-clock microseconds at itsBase, so that every process on a
+// host reads the same time base.
+static uint64_t itsBaseMicros;
+
+// Returns (a * b) >> 32 without overflowing for any 64-bit a and b below
+// 2^32.
+static uint64_t mulShift32(uint64_t a, uint64_t b)
+{
+    return (a >> 32) * b + (((a & 0xFFFFFFFFu) * b) >> 32);
+}
+
+static uint64_t multFor(uint64_t ticksPerSecond)
+{
+    return ((uint64_t)1000000 << 32) / ticksPerSecond;
+}
+
+#ifdef _WIN32
+
+static uint64_t monotonicNs(void)
+{
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000u +
+        (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000u / (uint64_t)freq.QuadPart;
+}
+
+static void sleepNs(uint64_t ns)
+{
+    Sleep((DWORD)(ns / 1000000));
+}
+
+static uint64_t fallbackTicks(void)
+{
+    LARGE_INTEGER count;
+
+    QueryPerformanceCounter(&count);
+    return (uint64_t)count.QuadPart;
+}
+
+static uint64_t fallbackTicksPerSecond(void)
+{
+    LARGE_INTEGER freq;
+
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)freq.QuadPart;
+}
+
+static bool hasInvariantTsc(void)
+{
+    int regs[4];
+
+    __cpuid(regs, 0x80000000);
+    if ((unsigned)regs[0] < 0x80000007u)
+    {
+        return false;
+    }
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+}
+
+#else
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void sleepNs(uint64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ns / 1000000000u);
+    ts.tv_nsec = (long)(ns % 1000000000u);
+    while (nanosleep(&ts, &ts) != 0)
+    {
+        ;
+    }
+}
+
+// The monotonic clock in nanoseconds is the fallback counter.
+static uint64_t fallbackTicks(void)
+{
+    return monotonicNs();
+}
+
+static uint64_t fallbackTicksPerSecond(void)
+{
+    return 1000000000u;
+}
+
+#ifdef HAVE_TSC
+static bool hasInvariantTsc(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+}
+#endif
+
+#endif
+
+#ifdef HAVE_TSC
+// Reads the TSC and the monotonic clock as close together as possible.
+static void samplePair(uint64_t* tsc, uint64_t* ns)
+{
+    uint64_t before = monotonicNs();
+
+    *tsc = __rdtsc();
+    *ns = before + (monotonicNs() - before) / 2;
+}
+#endif
+
+bool eventClockInit(void)
+{
+    itsUseTsc = false;
+
+#ifdef HAVE_TSC
+    if (hasInvariantTsc())
+    {
+        uint64_t tsc0, ns0, tsc1, ns1;
+
+        samplePair(&tsc0, &ns0);
+        sleepNs(CALIBRATION_NS);
+        samplePair(&tsc1, &ns1);
+        if (tsc1 > tsc0 && ns1 > ns0)
+        {
+            double ticksPerSecond = (double)(tsc1 - tsc0) * 1e9 / (double)(ns1 - ns0);
+
+            itsMult = multFor((uint64_t)ticksPerSecond);
+            itsBase = tsc1;
+            itsBaseMicros = ns1 / 1000;
+            itsUseTsc = true;
+            return true;
+        }
+    }
+#endif
+
+    itsMult = multFor(fallbackTicksPerSecond());
+    itsBase = 0;
+    itsBaseMicros = 0;
+    return false;
+}
+
+uint32_t eventClockMicros(void)
+{
+    uint64_t ticks;
+
+#ifdef HAVE_TSC
+    if (itsUseTsc)
+    {
+        ticks = __rdtsc() - itsBase;
+    }
+    else
+#endif
+    {
+        ticks = fallbackTicks() - itsBase;
+    }
+    return (uint32_t)(itsBaseMicros + mulShift32(ticks, itsMult)) & EVENT_TIMESTAMP_MASK;
+}
+
+uint32_t eventClockMicrosContext(void* context)
+{
+    (void)context;
+    return eventClockMicros();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A cheap microsecond clock for EventLog timestamps.
+//
+// On x86 with an invariant TSC, eventClockMicros() is one rdtsc and one
+// multiply-shift: the TSC rate is measured against the monotonic clock
+// in eventClockInit().  Elsewhere it falls back to clock_gettime()
+// (served from the vDSO on Linux) or QueryPerformanceCounter().
+//
+// For example,
+// eventClockInit();
+// eventSetTimeGetterFunc(eventClockMicros);
+// or, for one logger,
+// eventLoggerSetClock(&logger, eventClockMicrosContext, NULL);
+
+// Picks and calibrates the clock source.  Takes about 20 ms when the TSC
+// is used.  Returns true if the TSC is used.
+bool eventClockInit(void);
+
+// Microseconds of the host's monotonic clock, wrapped to the EventLog
+// timestamp width.  Processes on one host read the same time base, which
+// lets their logs be merged by timestamp; with the TSC, each process
+// drifts from it by its calibration error, a few microseconds per second
+// at most.
+uint32_t eventClockMicros(void);
+
+// The same, with the signature of an EventClockFunc.
+uint32_t eventClockMicrosContext(void* context);
@@ -0,0 +1,332 @@
+/*
+* @file EventCorrelate.c
+*
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "EventCorrelate.h"
+
+enum { SLOT_EMPTY, SLOT_SENT, SLOT_RECEIVED };
+
+static uint32_t slotOf(const EventCorrelator* corr, uint32_t id)
+{
+    return (id * 0x9E3779B1u) >> 7 & corr->mask;
+}
+
+static EventCorrelateEntry* find(EventCorrelator* corr, uint32_t id)
+{
+    for (uint32_t i = slotOf(corr, id); ; i = (i + 1) & corr->mask)
+    {
+        EventCorrelateEntry* entry = &corr->table[i];
+
+        if (entry->state == SLOT_EMPTY)
+        {
+            return NULL;
+        }
+        if (entry->id == id)
+        {
+            return entry;
+        }
+    }
+}
+
+// Removes an entry, shifting later entries of its probe run back so that
+// lookups never need tombstones.
+static void removeEntry(EventCorrelator* corr, EventCorrelateEntry* entry)
+{
+    uint32_t hole = (uint32_t)(entry - corr->table);
+    uint32_t i = hole;
+
+    for (;;)
+    {
+        uint32_t home;
+
+        i = (i + 1) & corr->mask;
+        if (corr->table[i].state == SLOT_EMPTY)
+        {
+            break;
+        }
+        home = slotOf(corr, corr->table[i].id);
+        // Move it if its home isn't cyclically in (hole, i].
+        if (((i - home) & corr->mask) >= ((i - hole) & corr->mask))
+        {
+            corr->table[hole] = corr->table[i];
+            hole = i;
+        }
+    }
+    corr->table[hole].state = SLOT_EMPTY;
+    corr->count--;
+}
+
+static void pushExpiry(EventCorrelator* corr, const EventCorrelateEntry* entry)
+{
+    uint32_t size = (corr->mask + 1) * 2;
+    EventCorrelateExpiry* rec = &corr->expiry[(corr->expiryHead + corr->expiryCount) & (size - 1)];
+
+    rec->id = entry->id;
+    rec->state = entry->state;
+    rec->time = entry->time;
+    corr->expiryCount++;
+}
+
+// Drops the oldest expiry record, and its entry if the record is still
+// current: a received entry leaves behind the record of its send.
+static void popExpiry(EventCorrelator* corr, bool early)
+{
+    uint32_t size = (corr->mask + 1) * 2;
+    EventCorrelateExpiry rec = corr->expiry[corr->expiryHead];
+    EventCorrelateEntry* entry;
+
+    corr->expiryHead = (corr->expiryHead + 1) & (size - 1);
+    corr->expiryCount--;
+
+    entry = find(corr, rec.id);
+    if (!entry || entry->state != rec.state || entry->time != rec.time)
+    {
+        return;
+    }
+    if (entry->state == SLOT_SENT)
+    {
+        if (early)
+        {
+            corr->senders[entry->source].evicted++;
+        }
+        else
+        {
+            corr->senders[entry->source].lost++;
+        }
+    }
+    removeEntry(corr, entry);
+}
+
+static void expire(EventCorrelator* corr)
+{
+    uint32_t size = (corr->mask + 1) * 2;
+
+    while (corr->expiryCount > 0 && corr->now - corr->expiry[corr->expiryHead].time > (int64_t)corr->window)
+    {
+        popExpiry(corr, false);
+    }
+    // Keep the table at most three quarters full, and room for a record.
+    while (corr->expiryCount > 0
+        && (corr->count >= (corr->mask + 1) / 4 * 3 || corr->expiryCount == size))
+    {
+        popExpiry(corr, true);
+    }
+}
+
+static EventCorrelateEntry* insert(EventCorrelator* corr, uint32_t id)
+{
+    uint32_t i = slotOf(corr, id);
+
+    while (corr->table[i].state != SLOT_EMPTY)
+    {
+        i = (i + 1) & corr->mask;
+    }
+    corr->count++;
+    corr->table[i].id = id;
+    return &corr->table[i];
+}
+
+static bool messageId(const EventData* event, uint32_t* id)
+{
+    switch (event->dataType)
+    {
+    case EVENT_DATA_BOOL:   *id = event->data.boolean; return true;
+    case EVENT_DATA_INT8:
+    case EVENT_DATA_UINT8:  *id = event->data.u8; return true;
+    case EVENT_DATA_INT16:
+    case EVENT_DATA_UINT16: *id = event->data.u16; return true;
+    case EVENT_DATA_INT32:
+    case EVENT_DATA_UINT32:
+    case EVENT_DATA_FLOAT:
+    case EVENT_DATA_STRING: *id = event->data.u32; return true;
+    default:                return false;
+    }
+}
+
+// Latencies of 2^31 us or more, possible with a window that long, share
+// the last bucket.
+static int bucketOf(uint32_t latency)
+{
+    int bucket = 0;
+
+    while (latency && bucket < EVENT_CORRELATE_BUCKETS - 1)
+    {
+        latency >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void advanceClock(EventCorrelator* corr, uint32_t raw)
+{
+    uint32_t delta;
+
+    raw &= EVENT_TIMESTAMP_MASK;
+    if (!corr->started)
+    {
+        corr->started = true;
+        corr->lastRaw = raw;
+        corr->now = raw;
+        return;
+    }
+    delta = (raw - corr->lastRaw) & EVENT_TIMESTAMP_MASK;
+    // A step back, from sources merged with a little jitter, doesn't move
+    // the clock backwards.
+    if (delta <= (EVENT_TIMESTAMP_MASK >> 1))
+    {
+        corr->now += delta;
+        corr->lastRaw = raw;
+    }
+}
+
+static void addSend(EventCorrelator* corr, uint32_t id, EventSource source)
+{
+    EventCorrelateEntry* entry = find(corr, id);
+
+    corr->senders[source].sent++;
+    if (entry && entry->state == SLOT_SENT)
+    {
+        corr->senders[source].resent++;
+    }
+    if (!entry)
+    {
+        entry = insert(corr, id);
+    }
+    // A resend restarts the clock; a send of a received ID starts a new
+    // message.
+    entry->state = SLOT_SENT;
+    entry->source = (uint8_t)source;
+    entry->seq = corr->nextSeq++;
+    entry->time = corr->now;
+    pushExpiry(corr, entry);
+}
+
+static void addReceive(EventCorrelator* corr, uint32_t id, EventSource source)
+{
+    EventCorrelateEntry* entry = find(corr, id);
+    EventRouteStats* route;
+    uint32_t latency;
+
+    if (!entry)
+    {
+        corr->orphans++;
+        return;
+    }
+    route = &corr->routes[entry->source][source];
+    if (entry->state == SLOT_RECEIVED)
+    {
+        route->duplicates++;
+        return;
+    }
+
+    latency = (uint32_t)(corr->now - entry->time);
+    if (route->matched == 0 || latency < route->latencyMin)
+    {
+        route->latencyMin = latency;
+    }
+    if (latency > route->latencyMax)
+    {
+        route->latencyMax = latency;
+    }
+    if (route->matched > 0 && (int32_t)(entry->seq - route->lastSeq) < 0)
+    {
+        route->reordered++;
+    }
+    else
+    {
+        route->lastSeq = entry->seq;
+    }
+    route->matched++;
+    route->latencySum += latency;
+    route->histogram[bucketOf(latency)]++;
+
+    // Kept for another window to catch duplicates.
+    entry->state = SLOT_RECEIVED;
+    entry->time = corr->now;
+    pushExpiry(corr, entry);
+}
+
+bool eventCorrelatorInit(EventCorrelator* corr, uint32_t capacity, uint32_t windowMicros)
+{
+    uint32_t size = 16;
+
+    memset(corr, 0, sizeof(*corr));
+    // Room for capacity entries at three quarters full.
+    while (size / 4 * 3 < capacity && size < (1u << 30))
+    {
+        size <<= 1;
+    }
+    corr->table = calloc(size, sizeof(EventCorrelateEntry));
+    corr->expiry = calloc((size_t)size * 2, sizeof(EventCorrelateExpiry));
+    if (!corr->table || !corr->expiry)
+    {
+        eventCorrelatorFree(corr);
+        return false;
+    }
+    corr->mask = size - 1;
+    corr->window = windowMicros;
+    return true;
+}
+
+void eventCorrelatorAdd(EventCorrelator* corr, const EventData* event)
+{
+    uint32_t id;
+
+    if (!event->valid || event->sourceID >= EVENT_SOURCE_COUNT)
+    {
+        return;
+    }
+    advanceClock(corr, event->timestamp);
+    expire(corr);
+    if ((event->eventID != EVENT_SEND && event->eventID != EVENT_RECEIVE) || !messageId(event, &id))
+    {
+        return;
+    }
+    if (event->eventID == EVENT_SEND)
+    {
+        addSend(corr, id, event->sourceID);
+    }
+    else
+    {
+        addReceive(corr, id, event->sourceID);
+    }
+}
+
+void eventCorrelatorFinish(EventCorrelator* corr)
+{
+    while (corr->expiryCount > 0)
+    {
+        popExpiry(corr, false);
+    }
+}
+
+uint32_t eventRouteLatencyPercentile(const EventRouteStats* route, double fraction)
+{
+    uint64_t target = (uint64_t)(fraction * (double)route->matched);
+    uint64_t seen = 0;
+
+    for (int i = 0; i < EVENT_CORRELATE_BUCKETS; i++)
+    {
+        seen += route->histogram[i];
+        if (i == EVENT_CORRELATE_BUCKETS - 1)
+        {
+            break;
+        }
+        if (seen > target || seen == route->matched)
+        {
+            return i == 0 ? 0 : (uint32_t)((1ull << i) - 1);
+        }
+    }
+    return route->latencyMax;
+}
+
+void eventCorrelatorFree(EventCorrelator* corr)
+{
+    free(corr->table);
+    free(corr->expiry);
+    corr->table = NULL;
+    corr->expiry = NULL;
+}
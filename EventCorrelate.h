@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "EventLog.h"
+
+// Pairs EVENT_SEND with EVENT_RECEIVE by message ID to measure one-way
+// latency and loss between sources.
+//
+// The message ID is the payload of both events; any integer type works,
+// and 4-character strings are taken as 32-bit IDs.  A send is matched by
+// the first receive with its ID from any source within the window, and
+// the pair is counted on the route from the sender's source to the
+// receiver's.  Per route this gives a latency histogram in powers of two
+// microseconds, and counts of
+// - duplicates: receives of a message already received within the window
+// - reordered: receives of a message sent before the last one received
+//   on the same route
+// Per sending source it counts
+// - lost: sends with no receive within the window
+// - resent: sends of an ID that is still waiting for its receive
+// and receives that match no send in the window are counted as orphans.
+//
+// State is one open-addressing hash table of messages sent or received in
+// the last window, expired in the order they were added, so memory is
+// fixed at eventCorrelatorInit() and each event costs a hash probe or two.
+// When the table is full the oldest entries are expired early and counted
+// as evicted.  Events must be fed in timestamp order, such as from one
+// capture or eventmerge.
+//
+// For example,
+// EventCorrelator corr;
+// eventCorrelatorInit(&corr, 1 << 16, 500000);
+// while (eventStreamNext(&stream, &view))
+//     eventCorrelatorAdd(&corr, &event);
+// eventCorrelatorFinish(&corr);
+// printf("%llu lost\n", corr.senders[EVENT_SOURCE_3].lost);
+
+#define EVENT_CORRELATE_BUCKETS 32
+
+typedef struct EventCorrelateEntry
+{
+	uint32_t id;
+	uint32_t seq;
+	int64_t time;
+	uint8_t source;
+	uint8_t state;
+} EventCorrelateEntry;
+
+typedef struct EventCorrelateExpiry
+{
+	uint32_t id;
+	uint8_t state;
+	int64_t time;
+} EventCorrelateExpiry;
+
+typedef struct EventRouteStats
+{
+	uint64_t matched;
+	uint64_t duplicates;
+	uint64_t reordered;
+	uint64_t latencySum;
+	uint32_t latencyMin;
+	uint32_t latencyMax;
+	uint32_t lastSeq;
+	// [i] counts latencies in [2^(i-1), 2^i) us; the last bucket also takes
+	// everything longer.
+	uint64_t histogram[EVENT_CORRELATE_BUCKETS];
+} EventRouteStats;
+
+typedef struct EventSenderStats
+{
+	uint64_t sent;
+	uint64_t lost;
+	uint64_t resent;
+	uint64_t evicted;
+} EventSenderStats;
+
+typedef struct EventCorrelator
+{
+	uint32_t window;
+	uint32_t mask;
+	uint32_t count;
+	EventCorrelateEntry* table;
+	EventCorrelateExpiry* expiry;
+	uint32_t expiryHead;
+	uint32_t expiryCount;
+
+	int64_t now;
+	uint32_t lastRaw;
+	bool started;
+	uint32_t nextSeq;
+
+	EventRouteStats routes[EVENT_SOURCE_COUNT][EVENT_SOURCE_COUNT];   // [from][to]
+	EventSenderStats senders[EVENT_SOURCE_COUNT];
+	uint64_t orphans;
+} EventCorrelator;
+
+// Sets up a correlator that tracks up to capacity messages, rounded up to
+// a power of two, for windowMicros each.  Returns false if out of memory.
+bool eventCorrelatorInit(EventCorrelator* corr, uint32_t capacity, uint32_t windowMicros);
+
+// Feeds in one event.  Events other than valid sends and receives with a
+// payload only move the clock on.
+void eventCorrelatorAdd(EventCorrelator* corr, const EventData* event);
+
+// Expires everything still waiting, as at the end of a capture.
+void eventCorrelatorFinish(EventCorrelator* corr);
+
+// Latency below which the given fraction of a route's messages arrived,
+// as the upper bound of its histogram bucket, or the longest latency seen
+// if that is the last bucket.
+uint32_t eventRouteLatencyPercentile(const EventRouteStats* route, double fraction);
+
+void eventCorrelatorFree(EventCorrelator* corr);
@@ -1,7 +1,10 @@
 #define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "EventLog.h"
+#include "EventSchema.h"
 
 
 #define STX '['
@@ -9,13 +12,16 @@
 #define ESC 27
 #define OFFSET 32
 
-// In the worst case, every byte in the packet requires an escape
-// character plus starting and ending framing characters. 
-#define FRAME_SIZE_MAX (PACKET_SIZE * 2 + 2)
-
 EventOutputFunc itsOutputFunc;
 EventTimeGetterFunc itsTimeGetterFunc;
 
+static void defaultSink(void* context, const char* buf, int len);
+static uint32_t defaultClock(void* context);
+
+// The logger behind the free functions.  It forwards to whatever
+// eventSetOutputFunc() and eventSetTimeGetterFunc() installed.
+static EventLogger itsDefaultLogger = { .sink = defaultSink, .clock = defaultClock };
+
 // Private
 typedef enum EventPayload {
     PAYLOAD_NONE,
@@ -57,13 +63,187 @@ typedef struct Packet
 // bytes in an event packet
 #define PACKET_SIZE sizeof(Packet)
 
-static void setHeader(Packet *p, EventLevel level, EventSource source, EventType type)
+// In the worst case, every byte in the packet requires an escape
+// character plus starting and ending framing characters. 
+#define FRAME_SIZE_MAX (PACKET_SIZE * 2 + 2)
+
+_Static_assert(PACKET_SIZE == EVENT_PACKET_SIZE, "EVENT_PACKET_SIZE doesn't match Packet");
+
+static void defaultSink(void* context, const char* buf, int len)
 {
-    uint32_t timestamp = 0;
+    (void)context;
+    if (itsOutputFunc)
+    {
+        itsOutputFunc(buf, len);
+    }
+}
 
+static uint32_t defaultClock(void* context)
+{
+    (void)context;
     if (itsTimeGetterFunc)
     {
-        timestamp = itsTimeGetterFunc();
+        return itsTimeGetterFunc();
+    }
+    return 0;
+}
+
+static void setHeader(EventLogger* logger, Packet* p, EventLevel level, EventSource source, EventType type);
+static void sendPacket(EventLogger* logger, const char* buf, int len);
+
+static bool laneFull(const EventLogger* logger, int level)
+{
+    const struct EventLane* lane;
+
+    if (level < EVENT_INFO || level > EVENT_ERROR)
+    {
+        return false;
+    }
+    lane = &logger->lanes[level];
+    return lane->slots && lane->count == lane->capacity;
+}
+
+// Emits one EVENT_SHED per level that lost events while the output path
+// was saturated.  A level whose lane is still full keeps its count for
+// later.  Returns true if nothing is left to report.
+static bool sendShedReport(EventLogger* logger)
+{
+    bool done = true;
+
+    for (int level = EVENT_INFO; level <= EVENT_ERROR; level++)
+    {
+        if (logger->shedPending[level] && laneFull(logger, level))
+        {
+            done = false;
+        }
+        else if (logger->shedPending[level])
+        {
+            Packet p = { 0 };
+
+            setHeader(logger, &p, (EventLevel)level, EVENT_SOURCE_UNSPECIFIED, EVENT_SHED);
+            p.format = PAYLOAD_UINT32;
+            p.u32 = logger->shedPending[level];
+            logger->shedPending[level] = 0;
+            sendPacket(logger, (const char*)&p, sizeof(p));
+        }
+    }
+    return done;
+}
+
+// The slow path of isEnabled(), taken only while shedding or while a
+// shed report is waiting to go out.
+static bool admitUnderPressure(EventLogger* logger, EventLevel level)
+{
+    if (level < logger->shedThreshold)
+    {
+        logger->shedPending[level]++;
+        logger->shedTotal[level]++;
+        return false;
+    }
+    if (logger->shedThreshold == EVENT_INFO && sendShedReport(logger))
+    {
+        logger->shedGate = EVENT_INFO;
+    }
+    return true;
+}
+
+static void setStr(Packet* p, const char* str)
+{
+    if (str)
+    {
+        strncpy(p->str, str, 4);
+    }
+    else
+    {
+        p->str[0] = 0;
+        p->str[1] = 0;
+        p->str[2] = 0;
+        p->str[3] = 0;
+    }
+}
+
+// Sends the EVENT_REPEATED that closes a source's run of repeats.
+static void sendRepeatReport(EventLogger* logger, uint8_t source)
+{
+    struct EventRepeatRun* run = &logger->repeats[source];
+    Packet p = { 0 };
+
+    p.level = run->level;
+    p.source = source;
+    p.type = EVENT_REPEATED;
+    p.format = PAYLOAD_UINT32;
+    p.timestamp = run->last;
+    p.u32 = run->count;
+    run->count = 0;
+    sendPacket(logger, (const char*)&p, sizeof(p));
+}
+
+// Sends a packet unless it repeats the previous event from its source.
+static void emitPacket(EventLogger* logger, const Packet* p)
+{
+    struct EventRepeatRun* run;
+    uint32_t payload;
+
+    if (!logger->collapseRepeats || p->source >= EVENT_SOURCE_COUNT)
+    {
+        sendPacket(logger, (const char*)p, sizeof(*p));
+        return;
+    }
+
+    run = &logger->repeats[p->source];
+    memcpy(&payload, p->str, sizeof(payload));
+    if (run->active && run->level == p->level && run->type == p->type &&
+        run->format == p->format && run->payload == payload)
+    {
+        if (run->count == 0)
+        {
+            run->first = p->timestamp;
+        }
+        run->count++;
+        run->last = p->timestamp;
+        if (logger->repeatWindow &&
+            ((run->last - run->first) & EVENT_TIMESTAMP_MASK) >= logger->repeatWindow)
+        {
+            sendRepeatReport(logger, p->source);
+        }
+        return;
+    }
+
+    if (run->count)
+    {
+        sendRepeatReport(logger, p->source);
+    }
+    run->active = true;
+    run->level = p->level;
+    run->type = p->type;
+    run->format = p->format;
+    run->payload = payload;
+    sendPacket(logger, (const char*)p, sizeof(*p));
+}
+
+static bool isEnabled(EventLogger* logger, EventLevel level, EventSource source)
+{
+    uint8_t src = (uint8_t)source;
+
+    if (level < logger->minLevel ||
+        (logger->sourceDisabled[src >> 5] & (1u << (src & 31))) != 0)
+    {
+        return false;
+    }
+    if (level < logger->shedGate)
+    {
+        return admitUnderPressure(logger, level);
+    }
+    return true;
+}
+
+static void setHeader(EventLogger* logger, Packet *p, EventLevel level, EventSource source, EventType type)
+{
+    uint32_t timestamp = 0;
+
+    if (logger->clock)
+    {
+        timestamp = logger->clock(logger->clockContext);
     }
 
     p->level = level;
@@ -73,12 +253,48 @@ static void setHeader(Packet *p, EventLevel level, EventSource source, EventType
     p->timestamp = timestamp;
 }
 
-static void sendPacket(const char* buf, int len)
+static uint32_t now(EventLogger* logger)
+{
+    return logger->clock ? logger->clock(logger->clockContext) : 0;
+}
+
+// Puts a frame on its level's lane.  Returns false if the level has no
+// lane; the level comes off the wire's four bits, so it may be no level
+// at all.
+static bool queueFrame(EventLogger* logger, int level, const char* frame, int len)
+{
+    struct EventLane* lane;
+    EventLaneSlot* slot;
+
+    if (level < EVENT_INFO || level > EVENT_ERROR || !logger->lanes[level].slots)
+    {
+        return false;
+    }
+    lane = &logger->lanes[level];
+    if (lane->count == lane->capacity)
+    {
+        lane->stats.dropped++;
+        logger->shedPending[level]++;
+        logger->shedTotal[level]++;
+        // Send the EVENT_SHED ahead of the next event.
+        logger->shedGate = EVENT_ERROR + 1;
+        return true;
+    }
+    slot = &lane->slots[(lane->head + lane->count) % lane->capacity];
+    slot->queuedAt = now(logger);
+    slot->len = (uint8_t)len;
+    memcpy(slot->frame, frame, (size_t)len);
+    lane->count++;
+    lane->bytes += (uint32_t)len;
+    return true;
+}
+
+static void sendPacket(EventLogger* logger, const char* buf, int len)
 {
     char frame[FRAME_SIZE_MAX] = { 0 };
     int n = 0;
 
-    if (!itsOutputFunc)
+    if (!logger->sink)
     {
         return;
     }
@@ -115,9 +331,16 @@ static void sendPacket(const char* buf, int len)
     frame[n] = ETX;
     n++;
 
-    itsOutputFunc(frame, n);
+    if (queueFrame(logger, ((const Packet*)buf)->level, frame, n))
+    {
+        return;
+    }
+    logger->sink(logger->sinkContext, frame, n);
 }
 
+// Bytes of payload carried by each wire format, indexed by EventPayload.
+static const uint8_t itsPayloadSize[PAYLOAD_STRING + 1] = { 0, 1, 1, 1, 2, 2, 4, 4, 4, 4 };
+
 static EventData convertPacketToEvent(Packet* pkt)
 {
     EventData event = { 0 };
@@ -125,56 +348,32 @@ static EventData convertPacketToEvent(Packet* pkt)
     event.sourceID = pkt->source;
     event.eventID = pkt->type;
     event.timestamp = pkt->timestamp;
-    switch (pkt->format)
+
+    // The wire formats and EventDataType share one numbering, and every
+    // payload sits at the start of both unions.
+    if (pkt->format <= PAYLOAD_STRING)
+    {
+        event.dataType = (enum EventDataType)pkt->format;
+        memcpy(&event.data, pkt->str, itsPayloadSize[pkt->format]);
+    }
+    else
     {
-    case PAYLOAD_BOOLEAN:
-        event.dataType = EVENT_DATA_BOOL;
-        event.data.boolean = pkt->boolean;
-        break;
-    case PAYLOAD_INT8:
-        event.dataType = EVENT_DATA_INT8;
-        event.data.s8 = pkt->s8;
-        break;
-    case PAYLOAD_UINT8:
-        event.dataType = EVENT_DATA_UINT8;
-        event.data.u8 = pkt->u8;
-        break;
-    case PAYLOAD_INT16:
-        event.dataType = EVENT_DATA_INT16;
-        event.data.s16 = pkt->s16;
-        break;
-    case PAYLOAD_UINT16:
-        event.dataType = EVENT_DATA_UINT16;
-        event.data.u16 = pkt->u16;
-        break;
-    case PAYLOAD_INT32:
-        event.dataType = EVENT_DATA_INT32;
-        event.data.s32 = pkt->s32;
-        break;
-    case PAYLOAD_UINT32:
-        event.dataType = EVENT_DATA_UINT32;
-        event.data.u16 = pkt->u32;
-        break;
-    case PAYLOAD_FLOAT:
-        event.dataType = EVENT_DATA_FLOAT;
-        event.data.f32 = pkt->f32;
-        break;
-    case PAYLOAD_STRING:
-        event.dataType = EVENT_DATA_STRING;
-        event.data.str[0] = pkt->str[0];
-        event.data.str[1] = pkt->str[1];
-        event.data.str[2] = pkt->str[2];
-        event.data.str[3] = pkt->str[3];
-        break;
-    case PAYLOAD_NONE:
-    default:
         event.dataType = EVENT_DATA_NONE;
-        event.data.u32 = 0;
-        break;
     }
     return event;
 }
 
+// Events listed in the schema must carry the payload the schema gives
+// them, except that a STOP listed without one may carry the U32 elapsed
+// time of a timed span.  Others are taken on trust.
+static bool matchesSchema(const Packet* pkt)
+{
+    const EventSchemaEntry* entry = eventSchemaLookup((EventSource)pkt->source, (EventType)pkt->type);
+
+    return !entry || (int)entry->dataType == pkt->format
+        || (entry->type == EVENT_STOP && entry->dataType == EVENT_DATA_NONE && pkt->format == PAYLOAD_UINT32);
+}
+
 EventData eventUnpackFrame(const char* frame, int size)
 {
     char buf[sizeof(Packet)] = {0};
@@ -232,7 +431,7 @@ EventData eventUnpackFrame(const char* frame, int size)
         memcpy((void*)&pkt, buf, sizeof(Packet));
         eventGood = convertPacketToEvent(&pkt);
         eventGood.frameSize = framePos;
-        eventGood.valid = true;
+        eventGood.valid = matchesSchema(&pkt);
         return eventGood;
     }
     else
@@ -244,121 +443,1005 @@ EventData eventUnpackFrame(const char* frame, int size)
     }
 }
 
-void eventSetOutputFunc(EventOutputFunc outputFunc)
+// Copies an escaped frame body into out.  Returns true if it unescapes
+// to exactly one packet.
+static bool unescapeBody(const char* body, int len, char* out)
 {
-    itsOutputFunc = outputFunc;
+    int n = 0;
+
+    for (int i = 0; i < len; i++)
+    {
+        char c = body[i];
+
+        if (c == ESC)
+        {
+            i++;
+            if (i >= len)
+            {
+                return false;
+            }
+            c = body[i];
+            if (c != STX + OFFSET && c != ETX + OFFSET && c != ESC + OFFSET)
+            {
+                return false;
+            }
+            c -= OFFSET;
+        }
+        if (n >= (int)PACKET_SIZE)
+        {
+            return false;
+        }
+        out[n] = c;
+        n++;
+    }
+    return n == (int)PACKET_SIZE;
 }
 
-void eventSetTimeGetterFunc(EventTimeGetterFunc timeGetterFunc)
+int64_t eventTimelineUnwrap(EventTimeline* timeline, uint32_t raw)
 {
-    itsTimeGetterFunc = timeGetterFunc;
+    uint32_t delta;
+
+    raw &= EVENT_TIMESTAMP_MASK;
+    if (!timeline->started)
+    {
+        timeline->started = true;
+        timeline->lastRaw = raw;
+        timeline->unwrapped = raw;
+        return timeline->unwrapped;
+    }
+    delta = (raw - timeline->lastRaw) & EVENT_TIMESTAMP_MASK;
+    if (delta > (EVENT_TIMESTAMP_MASK >> 1))
+    {
+        timeline->unwrapped -= (int64_t)(EVENT_TIMESTAMP_MASK + 1 - delta);
+    }
+    else
+    {
+        timeline->unwrapped += delta;
+    }
+    timeline->lastRaw = raw;
+    return timeline->unwrapped;
 }
 
-void event(EventLevel level, EventSource source, EventType type)
+void eventFrameIterInit(EventFrameIter* iter, const char* data, size_t size)
 {
-    Packet p = { 0 };
+    iter->pos = data;
+    iter->end = data + size;
+    iter->badFrames = 0;
+}
+
+bool eventFrameNext(EventFrameIter* iter, EventFrameView* view)
+{
+    while (iter->pos < iter->end)
+    {
+        const char* start = memchr(iter->pos, STX, iter->end - iter->pos);
+        const char* body;
+        const char* stop;
+        const char* restart;
+        size_t window;
+
+        if (!start)
+        {
+            iter->pos = iter->end;
+            return false;
+        }
+
+        body = start + 1;
+        window = iter->end - body;
+        if (window > FRAME_SIZE_MAX - 1)
+        {
+            window = FRAME_SIZE_MAX - 1;
+        }
+        stop = memchr(body, ETX, window);
 
-    setHeader(&p, level, source, type);
-    sendPacket((const char *) & p, sizeof(p));
+        // Unescaped packets are exactly PACKET_SIZE bytes with no escape
+        // character; anything else is either escaped, cut off, or garbage.
+        if (stop && stop - body == (ptrdiff_t)PACKET_SIZE && !memchr(body, ESC, PACKET_SIZE))
+        {
+            iter->pos = stop + 1;
+            view->frame = start;
+            view->frameSize = (int)(stop + 1 - start);
+            view->packet = body;
+            return true;
+        }
+
+        // A start character inside the body means the frame was cut off
+        // and a new one began.
+        restart = memchr(body, STX, stop ? (size_t)(stop - body) : window);
+        if (restart)
+        {
+            iter->badFrames++;
+            iter->pos = restart;
+            continue;
+        }
+
+        if (!stop)
+        {
+            if (window < FRAME_SIZE_MAX - 1)
+            {
+                // Possibly the start of a frame that isn't all here yet.
+                iter->pos = start;
+                return false;
+            }
+            iter->badFrames++;
+            iter->pos = body + window;
+            continue;
+        }
+
+        iter->pos = stop + 1;
+        if (unescapeBody(body, (int)(stop - body), view->unescaped))
+        {
+            view->frame = start;
+            view->frameSize = (int)(stop + 1 - start);
+            view->packet = view->unescaped;
+            return true;
+        }
+        iter->badFrames++;
+    }
+    return false;
 }
 
-void eventBool(EventLevel level, EventSource source, EventType type, bool val)
+// Copies just the four header bytes of a view's packet.
+static void viewHeader(const EventFrameView* view, Packet* pkt)
 {
-    Packet p = { 0 };
+    memcpy((void*)pkt, view->packet, offsetof(Packet, timestamp));
+}
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_BOOLEAN;
-    p.boolean = val;
-    sendPacket((const char*)&p, sizeof(p));
+EventLevel eventFrameLevel(const EventFrameView* view)
+{
+    Packet pkt;
+
+    viewHeader(view, &pkt);
+    return (EventLevel)pkt.level;
 }
 
-void eventU8(EventLevel level, EventSource source, EventType type, uint8_t val)
+EventSource eventFrameSource(const EventFrameView* view)
 {
-    Packet p = { 0 };
+    return (EventSource)(uint8_t)view->packet[offsetof(Packet, source)];
+}
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_UINT8;
-    p.u8 = val;
-    sendPacket((const char*)&p, sizeof(p));
+EventType eventFrameType(const EventFrameView* view)
+{
+    return (EventType)(uint8_t)view->packet[offsetof(Packet, type)];
 }
 
-void eventS8(EventLevel level, EventSource source, EventType type, int8_t val)
+uint32_t eventFrameTimestamp(const EventFrameView* view)
 {
-    Packet p = { 0 };
+    uint32_t timestamp;
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_INT8;
-    p.s8 = val;
-    sendPacket((const char*)&p, sizeof(p));
+    memcpy(&timestamp, view->packet + offsetof(Packet, timestamp), sizeof(timestamp));
+    return timestamp;
 }
 
-void eventU16(EventLevel level, EventSource source, EventType type, uint16_t val)
+enum EventDataType eventFrameDataType(const EventFrameView* view)
 {
-    Packet p = { 0 };
+    uint8_t format = (uint8_t)view->packet[offsetof(Packet, format)];
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_UINT16;
-    p.u16 = val;
-    sendPacket((const char*)&p, sizeof(p));
+    // The wire formats and EventDataType share one numbering.
+    return (format <= PAYLOAD_STRING) ? (enum EventDataType)format : EVENT_DATA_NONE;
 }
 
-void eventS16(EventLevel level, EventSource source, EventType type, int16_t val)
+union EventDataPayload eventFramePayload(const EventFrameView* view)
 {
-    Packet p = { 0 };
+    return eventFrameEvent(view).data;
+}
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_INT16;
-    p.s16 = val;
-    sendPacket((const char*)&p, sizeof(p));
+EventData eventFrameEvent(const EventFrameView* view)
+{
+    Packet pkt;
+    EventData event;
+
+    memcpy((void*)&pkt, view->packet, sizeof(Packet));
+    event = convertPacketToEvent(&pkt);
+    event.frameSize = view->frameSize;
+    event.valid = matchesSchema(&pkt);
+    return event;
 }
 
-void eventU32(EventLevel level, EventSource source, EventType type, uint32_t val)
+bool eventFrameValid(const EventFrameView* view)
 {
-    Packet p = { 0 };
+    Packet pkt;
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_UINT32;
-    p.u32 = val;
-    sendPacket((const char*)&p, sizeof(p));
+    memcpy((void*)&pkt, view->packet, sizeof(Packet));
+    return matchesSchema(&pkt);
 }
 
-void eventS32(EventLevel level, EventSource source, EventType type, int32_t val)
+void eventRepeatExpanderInit(EventRepeatExpander* expander)
 {
-    Packet p = { 0 };
+    memset(expander, 0, sizeof(*expander));
+}
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_INT32;
-    p.s32 = val;
-    sendPacket((const char*)&p, sizeof(p));
+void eventRepeatExpand(EventRepeatExpander* expander, const EventData* event, EventEmitFunc emit, void* context)
+{
+    unsigned source = (uint8_t)event->sourceID;
+
+    if (source >= EVENT_SOURCE_COUNT)
+    {
+        emit(context, event);
+        return;
+    }
+
+    if (event->eventID == EVENT_REPEATED && event->dataType == EVENT_DATA_UINT32 && expander->have[source])
+    {
+        EventData copy = expander->last[source];
+        uint32_t start = copy.timestamp;
+        uint32_t span = (event->timestamp - start) & EVENT_TIMESTAMP_MASK;
+        uint32_t count = event->data.u32;
+
+        for (uint32_t i = 1; i <= count; i++)
+        {
+            copy.timestamp = (start + (uint32_t)((uint64_t)span * i / count)) & EVENT_TIMESTAMP_MASK;
+            emit(context, &copy);
+        }
+        expander->last[source].timestamp = event->timestamp;
+        return;
+    }
+
+    expander->have[source] = true;
+    expander->last[source] = *event;
+    emit(context, event);
 }
 
-void eventFloat(EventLevel level, EventSource source, EventType type, float val)
+// True if timestamp a comes before b, allowing for rollover.
+static bool isEarlier(uint32_t a, uint32_t b)
 {
-    Packet p = { 0 };
+    return ((a - b) & EVENT_TIMESTAMP_MASK) > (EVENT_TIMESTAMP_MASK >> 1);
+}
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_FLOAT;
-    p.f32 = val;
-    sendPacket((const char*)&p, sizeof(p));
+void eventReorderInit(EventReorder* reorder, uint32_t hold)
+{
+    memset(reorder, 0, sizeof(*reorder));
+    reorder->hold = hold;
 }
 
-void eventStr(EventLevel level, EventSource source, EventType type, const char *str)
+void eventReorderPush(EventReorder* reorder, const EventData* event, EventEmitFunc emit, void* context)
 {
-    Packet p = { 0 };
+    int pos = reorder->count;
+    int due = 0;
 
-    setHeader(&p, level, source, type);
-    p.format = PAYLOAD_STRING;
-    if (str)
+    if (reorder->count == 0 || isEarlier(reorder->newest, event->timestamp))
     {
-        strncpy(p.str, str, 4);
+        reorder->newest = event->timestamp;
     }
-    else
+
+    // Events mostly arrive in order, so search from the end.  Equal
+    // timestamps keep their arrival order.
+    while (pos > 0 && isEarlier(event->timestamp, reorder->events[pos - 1].timestamp))
+    {
+        pos--;
+    }
+    memmove(&reorder->events[pos + 1], &reorder->events[pos], (size_t)(reorder->count - pos) * sizeof(EventData));
+    reorder->events[pos] = *event;
+    reorder->count++;
+
+    while (due < reorder->count &&
+        (reorder->count - due == EVENT_REORDER_MAX ||
+         ((reorder->newest - reorder->events[due].timestamp) & EVENT_TIMESTAMP_MASK) >= reorder->hold))
+    {
+        emit(context, &reorder->events[due]);
+        due++;
+    }
+    if (due)
+    {
+        reorder->count -= due;
+        memmove(&reorder->events[0], &reorder->events[due], (size_t)reorder->count * sizeof(EventData));
+    }
+}
+
+void eventReorderFlush(EventReorder* reorder, EventEmitFunc emit, void* context)
+{
+    for (int i = 0; i < reorder->count; i++)
     {
-        p.str[0] = 0;
-        p.str[1] = 0;
-        p.str[2] = 0;
-        p.str[3] = 0;
+        emit(context, &reorder->events[i]);
     }
-    sendPacket((const char *) & p, sizeof(p));
+    reorder->count = 0;
 }
 
+void eventStreamInit(EventStream* stream)
+{
+    stream->start = 0;
+    stream->len = 0;
+    stream->badFrames = 0;
+}
+
+char* eventStreamSpace(EventStream* stream, size_t* room)
+{
+    // Keep any partial frame at the front of the buffer.
+    if (stream->start > 0)
+    {
+        memmove(stream->buf, stream->buf + stream->start, stream->len - stream->start);
+        stream->len -= stream->start;
+        stream->start = 0;
+    }
+    // A buffer full of bytes with no complete frame is noise.
+    if (stream->len == sizeof(stream->buf))
+    {
+        stream->badFrames++;
+        stream->len = 0;
+    }
+    *room = sizeof(stream->buf) - stream->len;
+    return stream->buf + stream->len;
+}
+
+void eventStreamCommit(EventStream* stream, size_t n)
+{
+    stream->len += n;
+}
+
+bool eventStreamNext(EventStream* stream, EventFrameView* view)
+{
+    EventFrameIter iter;
+    bool found;
+
+    eventFrameIterInit(&iter, stream->buf + stream->start, stream->len - stream->start);
+    found = eventFrameNext(&iter, view);
+    stream->start = iter.pos - stream->buf;
+    stream->badFrames += iter.badFrames;
+    return found;
+}
+
+static const char* const itsLevelNames[] = { "INFO", "WARNING", "ERROR" };
+
+// Names are the enum names without their prefix.
+#define SOURCE_NAME(name) #name + sizeof("EVENT_SOURCE_") - 1,
+#define TYPE_NAME(name) #name + sizeof("EVENT_") - 1,
+
+static const char* const itsSourceNames[EVENT_SOURCE_COUNT] = { EVENT_SOURCE_LIST(SOURCE_NAME) };
+static const char* const itsTypeNames[EVENT_TYPE_COUNT] = { EVENT_TYPE_LIST(TYPE_NAME) };
+
+#define SCHEMA_ENTRY(name, lvl, src, typ, payload) { #name, lvl, src, typ, EVENT_SCHEMA_DATA_TYPE_##payload },
+#define SCHEMA_SLOT(name, lvl, src, typ, payload) [src][typ] = EVENT_SCHEMA_##name + 1,
+
+// One spare entry keeps the array legal while the schema is empty.
+static const EventSchemaEntry itsSchema[EVENT_SCHEMA_COUNT + 1] = { EVENT_SCHEMA(SCHEMA_ENTRY) };
+
+// One more than the schema index of each source and type pair, or 0.
+// Listing a pair twice draws an override-init warning.
+static const uint16_t itsSchemaIndex[EVENT_SOURCE_COUNT][EVENT_TYPE_COUNT] = { EVENT_SCHEMA(SCHEMA_SLOT) };
+
+const char* eventLevelName(EventLevel level)
+{
+    return ((unsigned)level <= EVENT_ERROR) ? itsLevelNames[level] : NULL;
+}
+
+const char* eventSourceName(EventSource source)
+{
+    return ((unsigned)source < EVENT_SOURCE_COUNT) ? itsSourceNames[source] : NULL;
+}
+
+const char* eventTypeName(EventType type)
+{
+    return ((unsigned)type < EVENT_TYPE_COUNT) ? itsTypeNames[type] : NULL;
+}
+
+const EventSchemaEntry* eventSchemaLookup(EventSource source, EventType type)
+{
+    uint16_t index;
+
+    if ((unsigned)source >= EVENT_SOURCE_COUNT || (unsigned)type >= EVENT_TYPE_COUNT)
+    {
+        return NULL;
+    }
+    index = itsSchemaIndex[source][type];
+    return index ? &itsSchema[index - 1] : NULL;
+}
+
+const char* eventSchemaName(EventSource source, EventType type)
+{
+    const EventSchemaEntry* entry = eventSchemaLookup(source, type);
+
+    return entry ? entry->name : NULL;
+}
+
+// Appends a string and returns the new end.
+static char* formatStr(char* p, const char* str)
+{
+    while (*str)
+    {
+        *p++ = *str++;
+    }
+    return p;
+}
+
+// Appends an unsigned number, zero padded to width digits.
+static char* formatU32(char* p, uint32_t val, int width)
+{
+    char digits[10];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + val % 10);
+        val /= 10;
+    } while (val);
+    while (width-- > n)
+    {
+        *p++ = '0';
+    }
+    while (n)
+    {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+static char* formatS32(char* p, int32_t val)
+{
+    if (val < 0)
+    {
+        *p++ = '-';
+        return formatU32(p, 0u - (uint32_t)val, 1);
+    }
+    return formatU32(p, (uint32_t)val, 1);
+}
+
+// Appends a name, or the number if there is no name for it.
+static char* formatName(char* p, const char* name, uint32_t val)
+{
+    return name ? formatStr(p, name) : formatU32(p, val, 1);
+}
+
+int eventFormat(const EventData* event, char* buf, int size)
+{
+    char line[EVENT_FORMAT_MAX];
+    char* p = line;
+    int len;
+
+    // Timestamps fit in 8 digits for the 24-bit wire clock; wider
+    // clocks just print wider.
+    p = formatU32(p, event->timestamp, 8);
+    *p++ = ' ';
+    p = formatName(p, eventLevelName(event->level), event->level);
+    *p++ = ' ';
+    p = formatName(p, eventSourceName(event->sourceID), (uint8_t)event->sourceID);
+    *p++ = ' ';
+    p = formatName(p, eventTypeName(event->eventID), (uint8_t)event->eventID);
+
+    switch (event->dataType)
+    {
+    case EVENT_DATA_BOOL:
+        p = formatStr(p, event->data.boolean ? " true" : " false");
+        break;
+    case EVENT_DATA_INT8:
+        *p++ = ' ';
+        p = formatS32(p, event->data.s8);
+        break;
+    case EVENT_DATA_UINT8:
+        *p++ = ' ';
+        p = formatU32(p, event->data.u8, 1);
+        break;
+    case EVENT_DATA_INT16:
+        *p++ = ' ';
+        p = formatS32(p, event->data.s16);
+        break;
+    case EVENT_DATA_UINT16:
+        *p++ = ' ';
+        p = formatU32(p, event->data.u16, 1);
+        break;
+    case EVENT_DATA_INT32:
+        *p++ = ' ';
+        p = formatS32(p, event->data.s32);
+        break;
+    case EVENT_DATA_UINT32:
+        *p++ = ' ';
+        p = formatU32(p, event->data.u32, 1);
+        break;
+    case EVENT_DATA_FLOAT:
+        // Floats are rare enough to leave to snprintf.
+        p += snprintf(p, 24, " %g", event->data.f32);
+        break;
+    case EVENT_DATA_STRING:
+        *p++ = ' ';
+        *p++ = '"';
+        for (int i = 0; i < 4 && event->data.str[i]; i++)
+        {
+            char c = event->data.str[i];
+            *p++ = (c >= ' ' && c <= '~') ? c : '.';
+        }
+        *p++ = '"';
+        break;
+    case EVENT_DATA_NONE:
+    default:
+        break;
+    }
+    *p++ = '\n';
+
+    len = (int)(p - line);
+    if (size <= 0)
+    {
+        return 0;
+    }
+    if (len >= size)
+    {
+        len = size - 1;
+    }
+    memcpy(buf, line, len);
+    buf[len] = 0;
+    return len;
+}
+
+void printEvent(const EventData* event)
+{
+    char line[EVENT_FORMAT_MAX];
+
+    eventFormat(event, line, sizeof(line));
+    fputs(line, stdout);
+}
+
+void eventSetOutputFunc(EventOutputFunc outputFunc)
+{
+    itsOutputFunc = outputFunc;
+}
+
+void eventSetTimeGetterFunc(EventTimeGetterFunc timeGetterFunc)
+{
+    itsTimeGetterFunc = timeGetterFunc;
+}
+
+EventLogger* eventDefaultLogger(void)
+{
+    return &itsDefaultLogger;
+}
+
+void eventLoggerInit(EventLogger* logger)
+{
+    memset(logger, 0, sizeof(*logger));
+}
+
+void eventLoggerSetSink(EventLogger* logger, EventSinkFunc sink, void* context)
+{
+    logger->sink = sink;
+    logger->sinkContext = context;
+}
+
+void eventLoggerSetClock(EventLogger* logger, EventClockFunc clock, void* context)
+{
+    logger->clock = clock;
+    logger->clockContext = context;
+}
+
+void eventLoggerSetMinLevel(EventLogger* logger, EventLevel minLevel)
+{
+    logger->minLevel = minLevel;
+}
+
+void eventLoggerEnableSource(EventLogger* logger, EventSource source, bool enable)
+{
+    uint8_t src = (uint8_t)source;
+
+    if (enable)
+    {
+        logger->sourceDisabled[src >> 5] &= ~(1u << (src & 31));
+    }
+    else
+    {
+        logger->sourceDisabled[src >> 5] |= 1u << (src & 31);
+    }
+}
+
+void eventLoggerSetBacklogCapacity(EventLogger* logger, uint32_t capacity)
+{
+    logger->backlogCapacity = capacity;
+    if (capacity == 0)
+    {
+        eventLoggerReportBacklog(logger, 0);
+    }
+}
+
+void eventLoggerReportBacklog(EventLogger* logger, uint32_t backlog)
+{
+    uint32_t capacity = logger->backlogCapacity;
+    uint8_t threshold = logger->shedThreshold;
+
+    if (capacity == 0 || backlog < capacity / 4)
+    {
+        threshold = EVENT_INFO;
+    }
+    else if (backlog >= capacity - capacity / 4)
+    {
+        threshold = EVENT_ERROR;
+    }
+    else if (backlog >= capacity / 2)
+    {
+        threshold = EVENT_WARNING;
+    }
+    else if (threshold == EVENT_ERROR)
+    {
+        threshold = EVENT_WARNING;
+    }
+
+    logger->shedThreshold = threshold;
+    if (threshold != EVENT_INFO)
+    {
+        logger->shedGate = threshold;
+    }
+    else if (logger->shedGate != EVENT_INFO)
+    {
+        // Route the next event of any level through the slow path so the
+        // shed report goes out ahead of it.
+        logger->shedGate = EVENT_ERROR + 1;
+    }
+}
+
+uint32_t eventLoggerShedCount(const EventLogger* logger, EventLevel level)
+{
+    return ((unsigned)level <= EVENT_ERROR) ? logger->shedTotal[level] : 0;
+}
+
+void eventLoggerCollapseRepeats(EventLogger* logger, bool enable, uint32_t window)
+{
+    if (!enable)
+    {
+        eventLoggerFlushRepeats(logger);
+        memset(logger->repeats, 0, sizeof(logger->repeats));
+    }
+    logger->collapseRepeats = enable;
+    logger->repeatWindow = window;
+}
+
+void eventLoggerFlushRepeats(EventLogger* logger)
+{
+    for (int source = 0; source < EVENT_SOURCE_COUNT; source++)
+    {
+        if (logger->repeats[source].count)
+        {
+            sendRepeatReport(logger, (uint8_t)source);
+        }
+    }
+}
+
+void eventLoggerSetLane(EventLogger* logger, EventLevel level, EventLaneSlot* slots, uint32_t count, uint8_t weight)
+{
+    struct EventLane* lane;
+
+    if ((unsigned)level > EVENT_ERROR)
+    {
+        return;
+    }
+    lane = &logger->lanes[level];
+    memset(lane, 0, sizeof(*lane));
+    if (slots && count)
+    {
+        lane->slots = slots;
+        lane->capacity = count;
+        lane->weight = weight ? weight : 1;
+    }
+}
+
+void eventLoggerSetLanePolicy(EventLogger* logger, EventLanePolicy policy)
+{
+    logger->lanePolicy = policy;
+}
+
+// Picks the lane to send from next.  Strict takes the highest level that
+// has a frame.  Weighted does the same among levels with credit left, and
+// gives every level its weight in credit again once none has any.
+static struct EventLane* nextLane(EventLogger* logger)
+{
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int level = EVENT_ERROR; level >= EVENT_INFO; level--)
+        {
+            struct EventLane* lane = &logger->lanes[level];
+
+            if (lane->count && (logger->lanePolicy == EVENT_LANES_STRICT || lane->credit))
+            {
+                return lane;
+            }
+        }
+        if (logger->lanePolicy == EVENT_LANES_STRICT)
+        {
+            return NULL;
+        }
+        for (int level = EVENT_INFO; level <= EVENT_ERROR; level++)
+        {
+            logger->lanes[level].credit = logger->lanes[level].weight;
+        }
+    }
+    return NULL;
+}
+
+int eventLoggerPump(EventLogger* logger, int maxFrames)
+{
+    int sent = 0;
+
+    while (sent < maxFrames)
+    {
+        struct EventLane* lane = nextLane(logger);
+        EventLaneSlot* slot;
+        uint32_t latency;
+
+        if (!lane)
+        {
+            break;
+        }
+        slot = &lane->slots[lane->head];
+        lane->head = (lane->head + 1) % lane->capacity;
+        lane->count--;
+        lane->bytes -= slot->len;
+        if (lane->credit)
+        {
+            lane->credit--;
+        }
+
+        latency = (now(logger) - slot->queuedAt) & EVENT_TIMESTAMP_MASK;
+        lane->stats.sent++;
+        lane->stats.latencySum += latency;
+        if (latency > lane->stats.latencyMax)
+        {
+            lane->stats.latencyMax = latency;
+        }
+        if (logger->sink)
+        {
+            logger->sink(logger->sinkContext, slot->frame, slot->len);
+        }
+        sent++;
+    }
+    return sent;
+}
+
+uint32_t eventLoggerLaneBacklog(const EventLogger* logger)
+{
+    uint32_t bytes = 0;
+
+    for (int level = EVENT_INFO; level <= EVENT_ERROR; level++)
+    {
+        bytes += logger->lanes[level].bytes;
+    }
+    return bytes;
+}
+
+const EventLaneStats* eventLoggerLaneStats(const EventLogger* logger, EventLevel level)
+{
+    return ((unsigned)level <= EVENT_ERROR) ? &logger->lanes[level].stats : NULL;
+}
+
+void eventLog(EventLogger* logger, EventLevel level, EventSource source, EventType type)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    emitPacket(logger, &p);
+}
+
+void eventLogBool(EventLogger* logger, EventLevel level, EventSource source, EventType type, bool val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_BOOLEAN;
+    p.boolean = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogU8(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint8_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_UINT8;
+    p.u8 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogS8(EventLogger* logger, EventLevel level, EventSource source, EventType type, int8_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_INT8;
+    p.s8 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogU16(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint16_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_UINT16;
+    p.u16 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogS16(EventLogger* logger, EventLevel level, EventSource source, EventType type, int16_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_INT16;
+    p.s16 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogU32(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint32_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_UINT32;
+    p.u32 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogS32(EventLogger* logger, EventLevel level, EventSource source, EventType type, int32_t val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_INT32;
+    p.s32 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogFloat(EventLogger* logger, EventLevel level, EventSource source, EventType type, float val)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_FLOAT;
+    p.f32 = val;
+    emitPacket(logger, &p);
+}
+
+void eventLogStr(EventLogger* logger, EventLevel level, EventSource source, EventType type, const char *str)
+{
+    Packet p = { 0 };
+
+    if (!isEnabled(logger, level, source))
+    {
+        return;
+    }
+    setHeader(logger, &p, level, source, type);
+    p.format = PAYLOAD_STRING;
+    setStr(&p, str);
+    emitPacket(logger, &p);
+}
+
+void event(EventLevel level, EventSource source, EventType type)
+{
+    eventLog(&itsDefaultLogger, level, source, type);
+}
+
+void eventBool(EventLevel level, EventSource source, EventType type, bool val)
+{
+    eventLogBool(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventU8(EventLevel level, EventSource source, EventType type, uint8_t val)
+{
+    eventLogU8(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventS8(EventLevel level, EventSource source, EventType type, int8_t val)
+{
+    eventLogS8(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventU16(EventLevel level, EventSource source, EventType type, uint16_t val)
+{
+    eventLogU16(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventS16(EventLevel level, EventSource source, EventType type, int16_t val)
+{
+    eventLogS16(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventU32(EventLevel level, EventSource source, EventType type, uint32_t val)
+{
+    eventLogU32(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventS32(EventLevel level, EventSource source, EventType type, int32_t val)
+{
+    eventLogS32(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventFloat(EventLevel level, EventSource source, EventType type, float val)
+{
+    eventLogFloat(&itsDefaultLogger, level, source, type, val);
+}
+
+void eventStr(EventLevel level, EventSource source, EventType type, const char *str)
+{
+    eventLogStr(&itsDefaultLogger, level, source, type, str);
+}
+
+// Emitters generated from EventSchema.h.  The header of each packet is a
+// constant; only the timestamp and payload are filled in per event.
+
+#define SCHEMA_FORMAT_NONE PAYLOAD_NONE
+#define SCHEMA_FORMAT_BOOL PAYLOAD_BOOLEAN
+#define SCHEMA_FORMAT_U8 PAYLOAD_UINT8
+#define SCHEMA_FORMAT_S8 PAYLOAD_INT8
+#define SCHEMA_FORMAT_U16 PAYLOAD_UINT16
+#define SCHEMA_FORMAT_S16 PAYLOAD_INT16
+#define SCHEMA_FORMAT_U32 PAYLOAD_UINT32
+#define SCHEMA_FORMAT_S32 PAYLOAD_INT32
+#define SCHEMA_FORMAT_FLOAT PAYLOAD_FLOAT
+#define SCHEMA_FORMAT_STR PAYLOAD_STRING
+
+#define SCHEMA_STORE_NONE
+#define SCHEMA_STORE_BOOL p.boolean = val;
+#define SCHEMA_STORE_U8 p.u8 = val;
+#define SCHEMA_STORE_S8 p.s8 = val;
+#define SCHEMA_STORE_U16 p.u16 = val;
+#define SCHEMA_STORE_S16 p.s16 = val;
+#define SCHEMA_STORE_U32 p.u32 = val;
+#define SCHEMA_STORE_S32 p.s32 = val;
+#define SCHEMA_STORE_FLOAT p.f32 = val;
+#define SCHEMA_STORE_STR setStr(&p, val);
+
+#define SCHEMA_FORWARD_NONE
+#define SCHEMA_FORWARD_BOOL , val
+#define SCHEMA_FORWARD_U8 , val
+#define SCHEMA_FORWARD_S8 , val
+#define SCHEMA_FORWARD_U16 , val
+#define SCHEMA_FORWARD_S16 , val
+#define SCHEMA_FORWARD_U32 , val
+#define SCHEMA_FORWARD_S32 , val
+#define SCHEMA_FORWARD_FLOAT , val
+#define SCHEMA_FORWARD_STR , val
+
+#define SCHEMA_EMITTERS(name, lvl, src, typ, payload) EVENT_SCHEMA_IF_FIXED_##lvl( \
+void eventLog##name(EventLogger* logger EVENT_SCHEMA_LOGGER_ARGS_##payload) \
+{ \
+    static const Packet header = { .level = lvl, .format = SCHEMA_FORMAT_##payload, .source = src, .type = typ }; \
+    Packet p; \
+\
+    if (!isEnabled(logger, lvl, src)) \
+    { \
+        return; \
+    } \
+    p = header; \
+    if (logger->clock) \
+    { \
+        p.timestamp = logger->clock(logger->clockContext); \
+    } \
+    SCHEMA_STORE_##payload \
+    emitPacket(logger, &p); \
+} \
+\
+void event##name(EVENT_SCHEMA_ARGS_##payload) \
+{ \
+    eventLog##name(&itsDefaultLogger SCHEMA_FORWARD_##payload); \
+})
+
+EVENT_SCHEMA(SCHEMA_EMITTERS)
+
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // The EventLog CSU writes debugging output in a structured format to
 // an output port.  Unlike the freeform prints of the debug log output,
 // the EventLog has one specific format focussed on reporting when
@@ -47,36 +54,54 @@ typedef enum EventLevel {
 	EVENT_ERROR
 } EventLevel;
 
+// Sources and event types are listed once here so that the enums and the
+// names printed by eventFormat() can't drift apart.  Add new entries at
+// the end of each list; the values go on the wire.
+
+#define EVENT_SOURCE_LIST(X) \
+	X(EVENT_SOURCE_UNSPECIFIED) \
+	X(EVENT_SOURCE_MAIN)    /* The literal "main" */ \
+	X(EVENT_SOURCE_1) \
+	X(EVENT_SOURCE_2) \
+	X(EVENT_SOURCE_3) \
+	X(EVENT_SOURCE_4) \
+	X(EVENT_SOURCE_5) \
+	X(EVENT_SOURCE_6) \
+	X(EVENT_SOURCE_7) \
+	X(EVENT_SOURCE_8) \
+	X(EVENT_SOURCE_9) \
+	X(EVENT_SOURCE_10) \
+	X(EVENT_SOURCE_11) \
+	X(EVENT_SOURCE_12)
+
+#define EVENT_TYPE_LIST(X) \
+	X(EVENT_GENERIC) \
+	X(EVENT_VERSION)     /* Returns a version number */ \
+	X(EVENT_INIT)        /* For subsystems, this is sent once at launch */ \
+	X(EVENT_FINI)        /* For subststems, this is sent once at shutdown */ \
+	X(EVENT_START)       /* For semaphore-guarded tasks, this is sent at the beginning of an iteration */ \
+	X(EVENT_STOP)        /* For semaphore-guarded taskss, this is sent at the end of an iteration */ \
+	X(EVENT_SEND)        /* Sending data. The payload should describe the message or data being sent */ \
+	X(EVENT_RECEIVE)     /* Receiving data. The payload should describe the message or data received */ \
+	X(EVENT_NEW_STATE)   /* Sent at a state change. The payload should describe the new state */ \
+	X(EVENT_7) \
+	X(EVENT_8) \
+	X(EVENT_SHED)        /* Sent when a saturated output path recovers. The level is the level that was shed, the payload (U32) is how many events were dropped */ \
+	X(EVENT_REPEATED)    /* The last event from this source repeated. The payload (U32) is how many times, the timestamp is the last repeat */ \
+	X(EVENT_CPU_USAGE)   /* CPU use of the process since the last sample. The payload (U32) is in hundredths of a percent of one CPU */ \
+	X(EVENT_TASK_USAGE)  /* The same for the thread mapped to this source */
+
+#define EVENT_ENUM_ENTRY(name) name,
+
 // Public
 typedef enum EventSource {
-	EVENT_SOURCE_UNSPECIFIED,
-	EVENT_SOURCE_MAIN,    // The literal "main"
-	EVENT_SOURCE_1,
-	EVENT_SOURCE_2,
-	EVENT_SOURCE_3,
-	EVENT_SOURCE_4,
-	EVENT_SOURCE_5,
-	EVENT_SOURCE_6,
-	EVENT_SOURCE_7,
-	EVENT_SOURCE_8,
-	EVENT_SOURCE_9,
-	EVENT_SOURCE_10,
-	EVENT_SOURCE_11,
-	EVENT_SOURCE_12
+	EVENT_SOURCE_LIST(EVENT_ENUM_ENTRY)
+	EVENT_SOURCE_COUNT
 } EventSource;
 
 typedef enum EventType {
-	EVENT_GENERIC,
-	EVENT_VERSION,     // Returns a version number 
-	EVENT_INIT,        // For subsystems, this is sent once at launch
-	EVENT_FINI,        // For subststems, this is sent once at shutdown
-	EVENT_START,       // For semaphore-guarded tasks, this is sent at the beginning of an iteration
-	EVENT_STOP,        // For semaphore-guarded taskss, this is sent at the end of an iteration
-	EVENT_SEND,        // Sending data. The payload should describe the message or data being sent
-	EVENT_RECEIVE,     // Receiving data. The payload should describe the message or data received
-	EVENT_NEW_STATE,   // Sent at a state change. The payload should describe the new state
-	EVENT_7,
-	EVENT_8,
+	EVENT_TYPE_LIST(EVENT_ENUM_ENTRY)
+	EVENT_TYPE_COUNT
 } EventType;
 
 enum EventDataType {
@@ -122,10 +147,118 @@ typedef struct EventData
 // lengths and write them to an output sink.
 typedef void (*EventOutputFunc)(const char* buf, int len);
 
+// Timestamps go on the wire as 24-bit microsecond counts and roll over
+// every 2^24 us, about 16.8 seconds.
+#define EVENT_TIMESTAMP_BITS 24
+#define EVENT_TIMESTAMP_MASK ((1u << EVENT_TIMESTAMP_BITS) - 1)
+
+// Follows a stream of timestamps across their rollovers.  Zero it before
+// the first timestamp.
+typedef struct EventTimeline
+{
+	bool started;
+	uint32_t lastRaw;
+	int64_t unwrapped;
+} EventTimeline;
+
+// Extends a 24-bit timestamp to a running 64-bit count.  A step back of
+// less than half the range is taken as slight disorder, not a rollover.
+int64_t eventTimelineUnwrap(EventTimeline* timeline, uint32_t raw);
+
 // Functions of this type should return the current time in milliseconds
 // since the start of some epoch.
 typedef uint32_t(*EventTimeGetterFunc)(void);
 
+// Functions of this type are the sink of one EventLogger. The context is
+// the pointer that was passed to eventLoggerSetSink().
+typedef void (*EventSinkFunc)(void* context, const char* buf, int len);
+
+// Functions of this type are the clock of one EventLogger. The context is
+// the pointer that was passed to eventLoggerSetClock().
+typedef uint32_t(*EventClockFunc)(void* context);
+
+// The largest SLIP frame an event can produce: every byte of the packet
+// escaped plus the starting and ending framing characters.
+#define EVENT_PACKET_SIZE 12
+#define EVENT_FRAME_SIZE_MAX (EVENT_PACKET_SIZE * 2 + 2)
+
+// A queued frame and when it was queued, by the logger's clock.
+typedef struct EventLaneSlot
+{
+	uint32_t queuedAt;
+	uint8_t len;
+	char frame[EVENT_FRAME_SIZE_MAX];
+} EventLaneSlot;
+
+typedef enum EventLanePolicy
+{
+	EVENT_LANES_STRICT,      // always the highest level that has a frame
+	EVENT_LANES_WEIGHTED     // each level in turn, up to its weight in frames
+} EventLanePolicy;
+
+typedef struct EventLaneStats
+{
+	uint32_t sent;
+	uint32_t dropped;        // lane full; also reported as EVENT_SHED
+	uint32_t latencyMax;     // time between queueing and sending, in clock units
+	uint64_t latencySum;
+} EventLaneStats;
+
+// An EventLogger carries everything one log stream needs: its sink, its
+// clock and its filters.  Loggers share no state, so one can be given to
+// each thread, core or simulated board.  Frames are built on the caller's
+// stack, but the shedding, repeat and lane state isn't locked; with any of
+// those turned on, don't emit to the same logger from two threads.
+typedef struct EventLogger
+{
+	EventSinkFunc sink;
+	void* sinkContext;
+	EventClockFunc clock;
+	void* clockContext;
+
+	// Events below this level are dropped.
+	EventLevel minLevel;
+	// Bit N set means events from EventSource N are dropped.
+	uint32_t sourceDisabled[256 / 32];
+
+	// Backpressure.  Levels below shedGate take the slow path in the emit
+	// functions; levels below shedThreshold are dropped and counted.
+	uint32_t backlogCapacity;
+	uint8_t shedGate;
+	uint8_t shedThreshold;
+	uint32_t shedPending[EVENT_ERROR + 1];
+	uint32_t shedTotal[EVENT_ERROR + 1];
+
+	// Run-length collapsing of repeated events, one run per source.
+	bool collapseRepeats;
+	uint32_t repeatWindow;
+	struct EventRepeatRun
+	{
+		bool active;
+		uint8_t level;
+		uint8_t type;
+		uint8_t format;
+		uint32_t payload;
+		uint32_t count;
+		uint32_t first;
+		uint32_t last;
+	} repeats[EVENT_SOURCE_COUNT];
+
+	// Priority lanes, one queue of frames per level.
+	EventLanePolicy lanePolicy;
+	struct EventLane
+	{
+		EventLaneSlot* slots;
+		uint32_t capacity;
+		uint32_t head;
+		uint32_t count;
+		uint32_t bytes;
+		uint8_t weight;
+		uint8_t credit;
+		EventLaneStats stats;
+	} lanes[EVENT_ERROR + 1];
+} EventLogger;
+
 void event(EventLevel level, EventSource source, EventType type);
 void eventBool(EventLevel level, EventSource source, EventType type, bool val);
 void eventU8(EventLevel level, EventSource source, EventType type, uint8_t val);
@@ -137,9 +270,135 @@ void eventS32(EventLevel level, EventSource source, EventType type, int32_t val)
 void eventFloat(EventLevel level, EventSource source, EventType type, float val);
 void eventStr(EventLevel level, EventSource source, EventType type, const char *str);
 
+void eventLog(EventLogger* logger, EventLevel level, EventSource source, EventType type);
+void eventLogBool(EventLogger* logger, EventLevel level, EventSource source, EventType type, bool val);
+void eventLogU8(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint8_t val);
+void eventLogS8(EventLogger* logger, EventLevel level, EventSource source, EventType type, int8_t val);
+void eventLogU16(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint16_t val);
+void eventLogS16(EventLogger* logger, EventLevel level, EventSource source, EventType type, int16_t val);
+void eventLogU32(EventLogger* logger, EventLevel level, EventSource source, EventType type, uint32_t val);
+void eventLogS32(EventLogger* logger, EventLevel level, EventSource source, EventType type, int32_t val);
+void eventLogFloat(EventLogger* logger, EventLevel level, EventSource source, EventType type, float val);
+void eventLogStr(EventLogger* logger, EventLevel level, EventSource source, EventType type, const char* str);
+
 EventData eventUnpackFrame(const char* frame, int size);
 void printEvent(const EventData* event);
 
+// Writes one line of text describing an event, with a trailing newline,
+// into buf.  Returns the length written, not counting the terminating NUL.
+// EVENT_FORMAT_MAX is always enough room.
+#define EVENT_FORMAT_MAX 96
+int eventFormat(const EventData* event, char* buf, int size);
+
+// Readable names for printing, such as "WARNING", "MAIN" or "NEW_STATE".
+// Values outside the lists give NULL.
+const char* eventLevelName(EventLevel level);
+const char* eventSourceName(EventSource source);
+const char* eventTypeName(EventType type);
+
+// A view of one frame inside a capture buffer.  Fields are decoded only
+// when asked for.  For the usual frame with no escaped bytes, packet
+// points straight into the capture; otherwise the frame is unescaped into
+// the view's own buffer.  A view is only good while the capture is.
+typedef struct EventFrameView
+{
+	const char* packet;
+	const char* frame;
+	int frameSize;
+	char unescaped[EVENT_PACKET_SIZE];
+} EventFrameView;
+
+// Walks the frames of a capture buffer, skipping noise and bad frames.
+typedef struct EventFrameIter
+{
+	const char* pos;
+	const char* end;
+	uint32_t badFrames;
+} EventFrameIter;
+
+void eventFrameIterInit(EventFrameIter* iter, const char* data, size_t size);
+
+// Fills in view with the next good frame.  Returns false at the end of the
+// buffer.  A frame cut off by the end of the buffer is left unread at
+// iter->pos.
+bool eventFrameNext(EventFrameIter* iter, EventFrameView* view);
+
+EventLevel eventFrameLevel(const EventFrameView* view);
+EventSource eventFrameSource(const EventFrameView* view);
+EventType eventFrameType(const EventFrameView* view);
+uint32_t eventFrameTimestamp(const EventFrameView* view);
+enum EventDataType eventFrameDataType(const EventFrameView* view);
+union EventDataPayload eventFramePayload(const EventFrameView* view);
+
+// Decodes the whole frame, as eventUnpackFrame() would.
+EventData eventFrameEvent(const EventFrameView* view);
+
+// Returns what eventFrameEvent(view).valid would, without decoding the
+// payload.
+bool eventFrameValid(const EventFrameView* view);
+
+// Expands EVENT_REPEATED back into the events it stands for, for tools
+// that want every event.  Feed it every decoded event in order; it calls
+// emit for each event that comes out.  The copies of a repeated event get
+// timestamps spread evenly up to the time of the EVENT_REPEATED.
+typedef void (*EventEmitFunc)(void* context, const EventData* event);
+
+typedef struct EventRepeatExpander
+{
+	bool have[EVENT_SOURCE_COUNT];
+	EventData last[EVENT_SOURCE_COUNT];
+} EventRepeatExpander;
+
+void eventRepeatExpanderInit(EventRepeatExpander* expander);
+void eventRepeatExpand(EventRepeatExpander* expander, const EventData* event, EventEmitFunc emit, void* context);
+
+// Puts events from lanes or merged streams back in timestamp order.  An
+// event is held until one at least hold clock units newer arrives, or
+// until EVENT_REORDER_MAX events are held, so hold should cover the
+// longest queueing latency.
+#define EVENT_REORDER_MAX 64
+
+typedef struct EventReorder
+{
+	uint32_t hold;
+	uint32_t newest;
+	int count;
+	EventData events[EVENT_REORDER_MAX];
+} EventReorder;
+
+void eventReorderInit(EventReorder* reorder, uint32_t hold);
+
+// Adds an event, and emits every held event that is due.
+void eventReorderPush(EventReorder* reorder, const EventData* event, EventEmitFunc emit, void* context);
+
+// Emits every held event.
+void eventReorderFlush(EventReorder* reorder, EventEmitFunc emit, void* context);
+
+// Decodes frames from a byte stream that arrives in pieces of any size,
+// such as reads from a serial port.  Frames split across reads are kept
+// until the rest arrives.
+#define EVENT_STREAM_BUFFER_SIZE 4096
+
+typedef struct EventStream
+{
+	char buf[EVENT_STREAM_BUFFER_SIZE];
+	size_t start;
+	size_t len;
+	uint32_t badFrames;
+} EventStream;
+
+void eventStreamInit(EventStream* stream);
+
+// Returns where the next read should go and how much room is there.
+char* eventStreamSpace(EventStream* stream, size_t* room);
+
+// Accounts for n bytes written at eventStreamSpace().
+void eventStreamCommit(EventStream* stream, size_t n);
+
+// Fills in view with the next complete frame, if there is one.  The view
+// is good until the next call to eventStreamSpace().
+bool eventStreamNext(EventStream* stream, EventFrameView* view);
+
 // For example,
 // eventU16(EVENT_INFO, EVENT_SOURCE_177_MANAGER, EVENT_SEND, 7777);
 // eventFloat(EVENT_WARNING, EVENT_SOURCE_MAIN_LOOP, EVENT_CPU_TOO_HIGH, cpuPercentage);
@@ -149,3 +408,82 @@ void eventSetOutputFunc(EventOutputFunc outputFunc);
 
 // Assigns the function EventLog will use to get the current program time in 1ms units.
 void eventSetTimeGetterFunc(EventTimeGetterFunc timeGetterFunc);
+
+// Returns the logger used by event(), eventU8(), etc. and configured by
+// eventSetOutputFunc() and eventSetTimeGetterFunc().
+EventLogger* eventDefaultLogger(void);
+
+// Resets a logger to no sink, no clock, and no filtering.
+void eventLoggerInit(EventLogger* logger);
+
+void eventLoggerSetSink(EventLogger* logger, EventSinkFunc sink, void* context);
+void eventLoggerSetClock(EventLogger* logger, EventClockFunc clock, void* context);
+
+// Drops events with a level below minLevel.
+void eventLoggerSetMinLevel(EventLogger* logger, EventLevel minLevel);
+
+// Enables or disables all events from one source.
+void eventLoggerEnableSource(EventLogger* logger, EventSource source, bool enable);
+
+// Sets the size of the output path's queue, in bytes.  Once set, the
+// logger sheds EVENT_INFO while the reported backlog is at least half of
+// it and EVENT_WARNING too from three quarters.  EVENT_ERROR is never
+// shed.  Shedding stops when the backlog drains below a quarter, and the
+// next event is preceded by one EVENT_SHED per level that lost events.
+// A capacity of 0 turns shedding off.
+void eventLoggerSetBacklogCapacity(EventLogger* logger, uint32_t capacity);
+
+// Called by the sink or its driver with the number of bytes still queued.
+// This only updates the shedding state; it never emits.
+void eventLoggerReportBacklog(EventLogger* logger, uint32_t backlog);
+
+// Returns how many events of a level have been shed since init.
+uint32_t eventLoggerShedCount(const EventLogger* logger, EventLevel level);
+
+// Turns on collapsing of repeated events.  When a source sends the same
+// event ID with the same level and payload as its previous event, the
+// repeat is held back and counted.  When the run ends, or when window
+// clock units have passed since the first held-back repeat (0 for no
+// limit), one EVENT_REPEATED goes out with the count as its payload and
+// the time of the last repeat as its timestamp.
+void eventLoggerCollapseRepeats(EventLogger* logger, bool enable, uint32_t window);
+
+// Sends the EVENT_REPEATED of every open run.  Call it periodically, or
+// at shutdown, so a source that went quiet mid-run is reported.
+void eventLoggerFlushRepeats(EventLogger* logger);
+
+// Gives a level a lane of count slots, so its frames are queued instead of
+// going straight to the sink.  Frames of levels without a lane still go
+// straight out, which suits EVENT_ERROR.  eventLoggerPump() then sends
+// queued frames, by policy, whenever the output path has room.  A frame
+// that finds its lane full is dropped and reported by EVENT_SHED.  A NULL
+// slots removes the lane; its frames must have been pumped.
+//
+// Lanes reorder the stream, so decoders that need it in order sort by
+// timestamp, for instance with an EventReorder.
+//
+// For example,
+// static EventLaneSlot infoLane[256];
+// static EventLaneSlot warningLane[64];
+// eventLoggerSetLane(&logger, EVENT_INFO, infoLane, 256, 1);
+// eventLoggerSetLane(&logger, EVENT_WARNING, warningLane, 64, 4);
+// eventLoggerSetLanePolicy(&logger, EVENT_LANES_WEIGHTED);
+// ...
+// void uartTxReady(void) { eventLoggerPump(&logger, 1); }
+void eventLoggerSetLane(EventLogger* logger, EventLevel level, EventLaneSlot* slots, uint32_t count, uint8_t weight);
+void eventLoggerSetLanePolicy(EventLogger* logger, EventLanePolicy policy);
+
+// Sends up to maxFrames queued frames to the sink.  Returns how many were
+// sent.
+int eventLoggerPump(EventLogger* logger, int maxFrames);
+
+// Bytes of frames waiting in all lanes.
+uint32_t eventLoggerLaneBacklog(const EventLogger* logger);
+
+// Returns NULL for a level other than EVENT_INFO, EVENT_WARNING or
+// EVENT_ERROR.
+const EventLaneStats* eventLoggerLaneStats(const EventLogger* logger, EventLevel level);
+
+#ifdef __cplusplus
+}
+#endif
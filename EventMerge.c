@@ -0,0 +1,247 @@
+/*
+* @file EventMerge.c
+*
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EventMerge.h"
+
+// Reads the next good frame from a capture file.
+static bool readEvent(FILE* file, EventStream* stream, EventData* event)
+{
+    EventFrameView view;
+
+    for (;;)
+    {
+        size_t room;
+        char* space;
+        size_t n;
+
+        while (eventStreamNext(stream, &view))
+        {
+            *event = eventFrameEvent(&view);
+            if (event->valid)
+            {
+                return true;
+            }
+        }
+        space = eventStreamSpace(stream, &room);
+        n = fread(space, 1, room, file);
+        if (n == 0)
+        {
+            return false;
+        }
+        eventStreamCommit(stream, n);
+    }
+}
+
+static bool advance(EventMergeInput* input, int origin)
+{
+    EventData event;
+
+    if (!input->file || !readEvent(input->file, &input->stream, &event))
+    {
+        input->have = false;
+        return false;
+    }
+    input->head.origin = origin;
+    input->head.event = event;
+    input->head.time = (int64_t)llround((double)eventTimelineUnwrap(&input->timeline, event.timestamp) * input->scale) + input->offset;
+    input->have = true;
+    return true;
+}
+
+static bool before(const EventMerge* merge, int a, int b)
+{
+    int64_t ta = merge->inputs[a].head.time;
+    int64_t tb = merge->inputs[b].head.time;
+
+    return ta < tb || (ta == tb && a < b);
+}
+
+static void siftDown(EventMerge* merge, int pos)
+{
+    int* heap = merge->heap;
+
+    for (;;)
+    {
+        int smallest = pos;
+        int left = 2 * pos + 1;
+        int right = left + 1;
+        int tmp;
+
+        if (left < merge->heapSize && before(merge, heap[left], heap[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < merge->heapSize && before(merge, heap[right], heap[smallest]))
+        {
+            smallest = right;
+        }
+        if (smallest == pos)
+        {
+            return;
+        }
+        tmp = heap[pos];
+        heap[pos] = heap[smallest];
+        heap[smallest] = tmp;
+        pos = smallest;
+    }
+}
+
+bool eventMergeInit(EventMerge* merge, int count)
+{
+    memset(merge, 0, sizeof(*merge));
+    merge->inputs = calloc((size_t)count, sizeof(EventMergeInput));
+    merge->heap = calloc((size_t)count, sizeof(int));
+    if (!merge->inputs || !merge->heap)
+    {
+        free(merge->inputs);
+        free(merge->heap);
+        merge->inputs = NULL;
+        merge->heap = NULL;
+        return false;
+    }
+    merge->count = count;
+    for (int i = 0; i < count; i++)
+    {
+        eventStreamInit(&merge->inputs[i].stream);
+        merge->inputs[i].scale = 1.0;
+    }
+    return true;
+}
+
+bool eventMergeOpen(EventMerge* merge, int index, const char* path, int64_t offsetMicros, double driftPpm)
+{
+    EventMergeInput* input = &merge->inputs[index];
+
+    input->file = fopen(path, "rb");
+    if (!input->file)
+    {
+        return false;
+    }
+    input->offset = offsetMicros;
+    input->scale = 1.0 + driftPpm / 1e6;
+    return true;
+}
+
+bool eventMergeNext(EventMerge* merge, EventMergeEvent* out)
+{
+    int top;
+
+    if (!merge->primed)
+    {
+        merge->primed = true;
+        for (int i = 0; i < merge->count; i++)
+        {
+            if (advance(&merge->inputs[i], i))
+            {
+                merge->heap[merge->heapSize++] = i;
+            }
+        }
+        for (int i = merge->heapSize / 2 - 1; i >= 0; i--)
+        {
+            siftDown(merge, i);
+        }
+    }
+
+    if (merge->heapSize == 0)
+    {
+        return false;
+    }
+
+    top = merge->heap[0];
+    *out = merge->inputs[top].head;
+    if (!advance(&merge->inputs[top], top))
+    {
+        merge->heap[0] = merge->heap[--merge->heapSize];
+    }
+    siftDown(merge, 0);
+    return true;
+}
+
+void eventMergeClose(EventMerge* merge)
+{
+    for (int i = 0; i < merge->count; i++)
+    {
+        if (merge->inputs[i].file)
+        {
+            fclose(merge->inputs[i].file);
+        }
+    }
+    free(merge->inputs);
+    free(merge->heap);
+    memset(merge, 0, sizeof(*merge));
+}
+
+// Finds the unwrapped times of the first and last sync event in a capture.
+static bool findSync(const char* path, EventSource syncSource, EventType syncType, int64_t* first, int64_t* last, uint64_t* count)
+{
+    EventStream stream;
+    EventTimeline timeline = { 0 };
+    EventData event;
+    FILE* file = fopen(path, "rb");
+
+    if (!file)
+    {
+        return false;
+    }
+    *count = 0;
+    eventStreamInit(&stream);
+    while (readEvent(file, &stream, &event))
+    {
+        // Every event is unwrapped, not just sync events, so that gaps
+        // between sync events longer than a rollover are still counted.
+        int64_t t = eventTimelineUnwrap(&timeline, event.timestamp);
+
+        if (event.sourceID == syncSource && event.eventID == syncType)
+        {
+            if (*count == 0)
+            {
+                *first = t;
+            }
+            *last = t;
+            (*count)++;
+        }
+    }
+    fclose(file);
+    return *count > 0;
+}
+
+bool eventMergeEstimate(const char* const* paths, int count, EventSource syncSource, EventType syncType,
+    int64_t* offsetMicros, double* driftPpm)
+{
+    int64_t refFirst = 0;
+    int64_t refLast = 0;
+    uint64_t refCount = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int64_t first = 0;
+        int64_t last = 0;
+        uint64_t n = 0;
+        double scale = 1.0;
+
+        if (!findSync(paths[i], syncSource, syncType, &first, &last, &n))
+        {
+            return false;
+        }
+        if (i == 0)
+        {
+            refFirst = first;
+            refLast = last;
+            refCount = n;
+        }
+        else if (n > 1 && refCount > 1 && last > first)
+        {
+            scale = (double)(refLast - refFirst) / (double)(last - first);
+        }
+        driftPpm[i] = (scale - 1.0) * 1e6;
+        offsetMicros[i] = refFirst - (int64_t)llround((double)first * scale);
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "EventLog.h"
+
+// Merges the captures of several boards into one stream ordered by
+// corrected time.
+//
+// Each capture's 24-bit timestamps are unwrapped on their own, then
+// mapped onto a common time base as
+//
+//   time = unwrapped * (1 + driftPpm / 1e6) + offsetMicros
+//
+// The offset and drift can be given, or estimated by eventMergeEstimate()
+// from a sync event that every board logs, such as a shared PPS.
+//
+// Inputs are read through a small buffer each and merged with a binary
+// heap, so memory doesn't grow with the size of the captures.
+//
+// For example,
+// EventMerge merge;
+// EventMergeEvent ev;
+// eventMergeInit(&merge, 2);
+// eventMergeOpen(&merge, 0, "board0.bin", 0, 0.0);
+// eventMergeOpen(&merge, 1, "board1.bin", -1520, 12.5);
+// while (eventMergeNext(&merge, &ev))
+//     printf("%d %lld\n", ev.origin, (long long)ev.time);
+// eventMergeClose(&merge);
+
+typedef struct EventMergeEvent
+{
+	int origin;       // index of the input it came from
+	int64_t time;     // corrected time in microseconds
+	EventData event;
+} EventMergeEvent;
+
+typedef struct EventMergeInput
+{
+	FILE* file;
+	EventStream stream;
+	int64_t offset;
+	double scale;
+	EventTimeline timeline;
+	bool have;
+	EventMergeEvent head;
+} EventMergeInput;
+
+typedef struct EventMerge
+{
+	int count;
+	EventMergeInput* inputs;
+	int* heap;
+	int heapSize;
+	bool primed;
+} EventMerge;
+
+// Sets up a merge of count inputs.  Returns false if out of memory.
+bool eventMergeInit(EventMerge* merge, int count);
+
+// Opens input index.  Returns false if the file can't be opened.
+bool eventMergeOpen(EventMerge* merge, int index, const char* path, int64_t offsetMicros, double driftPpm);
+
+// Gets the next event in corrected time order.  Ties go to the lower
+// input index.  Returns false when every input is exhausted.
+bool eventMergeNext(EventMerge* merge, EventMergeEvent* out);
+
+void eventMergeClose(EventMerge* merge);
+
+// Estimates offsets and drifts that line up the given sync event in every
+// capture with its time in the first one, using the first and last time
+// it occurs in each.  Each capture is read through once.  Returns false if
+// a capture can't be read or doesn't contain the sync event; with only
+// one sync event in a capture its drift is left at 0.
+bool eventMergeEstimate(const char* const* paths, int count, EventSource syncSource, EventType syncType,
+	int64_t* offsetMicros, double* driftPpm);
@@ -0,0 +1,468 @@
+/*
+* @file EventQuery.c
+*
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "EventQuery.h"
+
+// Must match the framing in EventLog.c.
+#define STX '['
+
+typedef struct QueryChunk
+{
+    const EventQuery* query;
+    const char* data;
+    size_t size;
+    EventQueryResult* result;
+    // The timeline before the chunk's first frame.
+    EventQueryTimeline timeline;
+    // The chunk's own timeline, started from its first frame.
+    uint32_t firstRaw;
+    EventQueryTimeline span;
+    bool ok;
+    bool threaded;
+} QueryChunk;
+
+static bool testBit(const uint32_t* mask, uint8_t bit)
+{
+    return (mask[bit >> 5] & (1u << (bit & 31))) != 0;
+}
+
+// Converts a payload to a number.  Returns false for payloads that have
+// no numeric value.
+static bool payloadValue(const EventFrameView* view, double* value)
+{
+    enum EventDataType type = eventFrameDataType(view);
+    union EventDataPayload data;
+
+    if (type == EVENT_DATA_NONE || type == EVENT_DATA_STRING)
+    {
+        return false;
+    }
+
+    data = eventFramePayload(view);
+    switch (type)
+    {
+    case EVENT_DATA_BOOL:   *value = data.boolean ? 1.0 : 0.0; break;
+    case EVENT_DATA_INT8:   *value = data.s8; break;
+    case EVENT_DATA_UINT8:  *value = data.u8; break;
+    case EVENT_DATA_INT16:  *value = data.s16; break;
+    case EVENT_DATA_UINT16: *value = data.u16; break;
+    case EVENT_DATA_INT32:  *value = data.s32; break;
+    case EVENT_DATA_UINT32: *value = data.u32; break;
+    case EVENT_DATA_FLOAT:  *value = data.f32; break;
+    default: return false;
+    }
+    return true;
+}
+
+// Applies every filter of a query to one frame.  The payload is decoded
+// only if needValue is set or the query filters on it.
+static bool matchFrame(const EventQuery* query, EventQueryTimeline* timeline, const EventFrameView* view,
+    bool needValue, double* value, bool* hasValue)
+{
+    EventLevel level = eventFrameLevel(view);
+
+    // The timeline has to see every frame, so this goes first.
+    if (query->timeFilter)
+    {
+        int64_t time = eventTimelineUnwrap(timeline, eventFrameTimestamp(view));
+
+        if (time < query->timeMin || time > query->timeMax)
+        {
+            return false;
+        }
+    }
+    if ((query->levels & (1u << level)) == 0 ||
+        !testBit(query->sources, (uint8_t)eventFrameSource(view)) ||
+        !testBit(query->types, (uint8_t)eventFrameType(view)))
+    {
+        return false;
+    }
+
+    if (needValue || query->payloadFilter)
+    {
+        *hasValue = payloadValue(view, value);
+    }
+    if (query->payloadFilter &&
+        (!*hasValue || *value < query->payloadMin || *value > query->payloadMax))
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool addValue(EventQueryStats* stats, double value, bool keep)
+{
+    if (stats->valueCount == 0 || value < stats->min)
+    {
+        stats->min = value;
+    }
+    if (stats->valueCount == 0 || value > stats->max)
+    {
+        stats->max = value;
+    }
+    stats->sum += value;
+    stats->valueCount++;
+
+    if (keep)
+    {
+        if (stats->valueCount > stats->capacity)
+        {
+            size_t capacity = stats->capacity ? stats->capacity * 2 : 1024;
+            double* values = realloc(stats->values, capacity * sizeof(double));
+
+            if (!values)
+            {
+                return false;
+            }
+            stats->values = values;
+            stats->capacity = capacity;
+        }
+        stats->values[stats->valueCount - 1] = value;
+    }
+    return true;
+}
+
+static int scanChunk(void* arg)
+{
+    QueryChunk* chunk = arg;
+    const EventQuery* query = chunk->query;
+    EventQueryResult* result = chunk->result;
+    bool needValue = query->payloadFilter || query->payloadStats || query->percentiles;
+    EventQueryTimeline timeline = chunk->timeline;
+    EventFrameIter iter;
+    EventFrameView view;
+
+    chunk->ok = true;
+    eventFrameIterInit(&iter, chunk->data, chunk->size);
+    while (eventFrameNext(&iter, &view))
+    {
+        EventQueryStats* stats;
+        double value = 0.0;
+        bool hasValue = false;
+
+        if (!matchFrame(query, &timeline, &view, needValue, &value, &hasValue))
+        {
+            continue;
+        }
+        // As in eventcat and the merge, a frame that breaks the schema is
+        // not counted.
+        if (!eventFrameValid(&view))
+        {
+            result->badFrames++;
+            continue;
+        }
+
+        switch (query->groupBy)
+        {
+        case EVENT_QUERY_GROUP_SOURCE: stats = &result->groups[(uint8_t)eventFrameSource(&view)]; break;
+        case EVENT_QUERY_GROUP_TYPE:   stats = &result->groups[(uint8_t)eventFrameType(&view)]; break;
+        default:                       stats = &result->groups[0]; break;
+        }
+        stats->count++;
+        if (hasValue && !addValue(stats, value, query->percentiles))
+        {
+            chunk->ok = false;
+            break;
+        }
+    }
+    result->badFrames += iter.badFrames;
+    return 0;
+}
+
+// Follows the timestamps through a chunk from its first frame, for the
+// chunks after it.
+static int spanChunk(void* arg)
+{
+    QueryChunk* chunk = arg;
+    EventFrameIter iter;
+    EventFrameView view;
+
+    eventFrameIterInit(&iter, chunk->data, chunk->size);
+    while (eventFrameNext(&iter, &view))
+    {
+        uint32_t raw = eventFrameTimestamp(&view);
+
+        if (!chunk->span.started)
+        {
+            chunk->firstRaw = raw & EVENT_TIMESTAMP_MASK;
+        }
+        eventTimelineUnwrap(&chunk->span, raw);
+    }
+    return 0;
+}
+
+// Moves a timeline past a chunk that spanChunk() has followed.
+static void skipChunk(EventQueryTimeline* timeline, const QueryChunk* chunk)
+{
+    int64_t first;
+
+    if (!chunk->span.started)
+    {
+        return;
+    }
+    first = eventTimelineUnwrap(timeline, chunk->firstRaw);
+    timeline->lastRaw = chunk->span.lastRaw;
+    timeline->unwrapped = first + (chunk->span.unwrapped - chunk->firstRaw);
+}
+
+// Runs func on each of n chunks, on a thread of its own where one can be
+// had.
+static void runChunks(QueryChunk* chunks, thrd_t* threads, int n, thrd_start_t func)
+{
+    for (int i = 0; i < n; i++)
+    {
+        chunks[i].threaded = thrd_create(&threads[i], func, &chunks[i]) == thrd_success;
+        if (!chunks[i].threaded)
+        {
+            func(&chunks[i]);
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        if (chunks[i].threaded)
+        {
+            thrd_join(threads[i], NULL);
+        }
+    }
+}
+
+// Folds one thread's result into the final result.
+static bool mergeResult(EventQueryResult* into, EventQueryResult* from)
+{
+    for (int g = 0; g < EVENT_QUERY_GROUPS; g++)
+    {
+        EventQueryStats* a = &into->groups[g];
+        EventQueryStats* b = &from->groups[g];
+
+        if (b->valueCount)
+        {
+            if (a->valueCount == 0 || b->min < a->min)
+            {
+                a->min = b->min;
+            }
+            if (a->valueCount == 0 || b->max > a->max)
+            {
+                a->max = b->max;
+            }
+        }
+        if (b->values)
+        {
+            size_t n = a->valueCount + b->valueCount;
+
+            if (n > a->capacity)
+            {
+                double* values = realloc(a->values, n * sizeof(double));
+
+                if (!values)
+                {
+                    return false;
+                }
+                a->values = values;
+                a->capacity = n;
+            }
+            memcpy(a->values + a->valueCount, b->values, b->valueCount * sizeof(double));
+        }
+        a->count += b->count;
+        a->valueCount += b->valueCount;
+        a->sum += b->sum;
+    }
+    into->badFrames += from->badFrames;
+    return true;
+}
+
+static int compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+void eventQueryInit(EventQuery* query)
+{
+    memset(query, 0, sizeof(*query));
+    query->levels = (1u << EVENT_INFO) | (1u << EVENT_WARNING) | (1u << EVENT_ERROR);
+    memset(query->sources, 0xFF, sizeof(query->sources));
+    memset(query->types, 0xFF, sizeof(query->types));
+    query->groupBy = EVENT_QUERY_GROUP_NONE;
+}
+
+void eventQueryOnlyLevel(EventQuery* query, EventLevel level)
+{
+    query->levels = (uint8_t)(1u << level);
+}
+
+void eventQueryOnlySource(EventQuery* query, EventSource source)
+{
+    uint8_t src = (uint8_t)source;
+
+    memset(query->sources, 0, sizeof(query->sources));
+    query->sources[src >> 5] = 1u << (src & 31);
+}
+
+void eventQueryOnlyType(EventQuery* query, EventType type)
+{
+    uint8_t t = (uint8_t)type;
+
+    memset(query->types, 0, sizeof(query->types));
+    query->types[t >> 5] = 1u << (t & 31);
+}
+
+bool eventQueryMatch(const EventQuery* query, EventQueryTimeline* timeline, const EventFrameView* view)
+{
+    double value;
+    bool hasValue = false;
+
+    return matchFrame(query, timeline, view, false, &value, &hasValue);
+}
+
+bool eventQueryRun(const EventQuery* query, const char* data, size_t size, int nThreads, EventQueryResult* result)
+{
+    QueryChunk* chunks;
+    EventQueryResult* partial;
+    thrd_t* threads;
+    bool ok = true;
+    size_t start = 0;
+    int n = 0;
+
+    memset(result, 0, sizeof(*result));
+    if (nThreads < 1)
+    {
+        nThreads = 1;
+    }
+    // Small captures aren't worth a thread each.
+    if (size / nThreads < 64 * 1024)
+    {
+        nThreads = (int)(size / (64 * 1024)) + 1;
+    }
+
+    if (nThreads == 1)
+    {
+        QueryChunk chunk = { .query = query, .data = data, .size = size, .result = result };
+
+        scanChunk(&chunk);
+        ok = chunk.ok;
+    }
+    else
+    {
+        chunks = calloc(nThreads, sizeof(QueryChunk));
+        partial = calloc(nThreads, sizeof(EventQueryResult));
+        threads = calloc(nThreads, sizeof(thrd_t));
+        if (!chunks || !partial || !threads)
+        {
+            free(chunks);
+            free(partial);
+            free(threads);
+            return false;
+        }
+
+        // Frames never contain a raw start character, so cutting the
+        // buffer just before one never splits a frame.
+        for (int i = 0; i < nThreads && start < size; i++)
+        {
+            size_t end = (i == nThreads - 1) ? size : size / nThreads * (i + 1);
+            const char* next;
+
+            if (end < start)
+            {
+                end = start;
+            }
+            next = memchr(data + end, STX, size - end);
+            end = next ? (size_t)(next - data) : size;
+
+            chunks[n].query = query;
+            chunks[n].data = data + start;
+            chunks[n].size = end - start;
+            chunks[n].result = &partial[n];
+            n++;
+            start = end;
+        }
+
+        // A chunk's timestamps can only be unwrapped once the time it
+        // starts at is known, which takes a pass over those before it.
+        if (query->timeFilter)
+        {
+            runChunks(chunks, threads, n - 1, spanChunk);
+            for (int i = 1; i < n; i++)
+            {
+                chunks[i].timeline = chunks[i - 1].timeline;
+                skipChunk(&chunks[i].timeline, &chunks[i - 1]);
+            }
+        }
+        runChunks(chunks, threads, n, scanChunk);
+
+        for (int i = 0; i < n; i++)
+        {
+            ok = ok && chunks[i].ok && mergeResult(result, &partial[i]);
+            for (int g = 0; g < EVENT_QUERY_GROUPS; g++)
+            {
+                free(partial[i].groups[g].values);
+            }
+        }
+        free(chunks);
+        free(partial);
+        free(threads);
+    }
+
+    if (query->percentiles)
+    {
+        for (int g = 0; g < EVENT_QUERY_GROUPS; g++)
+        {
+            EventQueryStats* stats = &result->groups[g];
+
+            if (stats->values)
+            {
+                qsort(stats->values, stats->valueCount, sizeof(double), compareDouble);
+            }
+        }
+    }
+    return ok;
+}
+
+void eventQueryFree(EventQueryResult* result)
+{
+    for (int g = 0; g < EVENT_QUERY_GROUPS; g++)
+    {
+        free(result->groups[g].values);
+        result->groups[g].values = NULL;
+        result->groups[g].capacity = 0;
+    }
+}
+
+double eventQueryMean(const EventQueryResult* result, int group)
+{
+    const EventQueryStats* stats = &result->groups[group];
+
+    return stats->valueCount ? stats->sum / (double)stats->valueCount : 0.0;
+}
+
+double eventQueryPercentile(const EventQueryResult* result, int group, double percent)
+{
+    const EventQueryStats* stats = &result->groups[group];
+    size_t rank;
+
+    if (!stats->values || stats->valueCount == 0)
+    {
+        return 0.0;
+    }
+    if (percent <= 0.0)
+    {
+        return stats->values[0];
+    }
+    if (percent >= 100.0)
+    {
+        return stats->values[stats->valueCount - 1];
+    }
+    // Nearest-rank percentile.
+    rank = (size_t)(percent / 100.0 * (double)stats->valueCount + 0.999999);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    return stats->values[rank - 1];
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "EventLog.h"
+
+// EventQuery answers questions like "how many EVENT_RECEIVE from source 5
+// had a payload over 1000 in the last hour" over a capture buffer,
+// typically one mapped with eventCaptureOpen().
+//
+// Filters on level, source, type and time are checked against the frame
+// header while scanning, so events that fail them are never decoded.
+// Timestamps are unwrapped across their 24-bit rollovers before the time
+// filter sees them, as in EventMerge, so a time window may span any number
+// of rollovers.  Like EventMerge, this needs no gap of half a rollover
+// period or more between consecutive events.  The
+// payload is decoded only for events that pass and only if the query
+// filters on it or aggregates it.  Frame starts are found with memchr(),
+// which the C library vectorizes, and large captures are split across
+// threads.
+//
+// For example,
+// EventQuery q;
+// EventQueryResult r;
+// eventQueryInit(&q);
+// eventQueryOnlySource(&q, EVENT_SOURCE_5);
+// eventQueryOnlyType(&q, EVENT_RECEIVE);
+// q.payloadFilter = true;
+// q.payloadMin = 1001;
+// if (eventQueryRun(&q, cap.data, cap.size, 4, &r))
+//     printf("%llu\n", (unsigned long long)r.groups[0].count);
+// eventQueryFree(&r);
+
+typedef enum EventQueryGroup
+{
+	EVENT_QUERY_GROUP_NONE,
+	EVENT_QUERY_GROUP_SOURCE,
+	EVENT_QUERY_GROUP_TYPE
+} EventQueryGroup;
+
+#define EVENT_QUERY_GROUPS 256
+
+typedef struct EventQuery
+{
+	// Bit N set accepts level, source or type N.  eventQueryInit() sets
+	// all of them.
+	uint8_t levels;
+	uint32_t sources[256 / 32];
+	uint32_t types[256 / 32];
+
+	// When set, only events whose unwrapped timestamp is in the inclusive
+	// range [timeMin, timeMax] match.  The first frame's unwrapped
+	// timestamp is its raw one, so a capture shorter than one rollover
+	// that doesn't roll over can be filtered on raw timestamps.
+	bool timeFilter;
+	int64_t timeMin;
+	int64_t timeMax;
+
+	// When set, only events with a numeric payload in the inclusive range
+	// [payloadMin, payloadMax] match.
+	bool payloadFilter;
+	double payloadMin;
+	double payloadMax;
+
+	EventQueryGroup groupBy;
+
+	// When set, min, max and mean of numeric payloads are gathered.
+	bool payloadStats;
+
+	// When set, matching payload values are kept so that
+	// eventQueryPercentile() can be used on the result.
+	bool percentiles;
+} EventQuery;
+
+typedef struct EventQueryStats
+{
+	// Events that matched.
+	uint64_t count;
+	// Of those, events with a numeric payload, and their min, max and sum.
+	uint64_t valueCount;
+	double min;
+	double max;
+	double sum;
+
+	// Private. Kept values when EventQuery.percentiles is set.
+	double* values;
+	size_t capacity;
+} EventQueryStats;
+
+// Follows the timestamps of a stream of frames across their rollovers.
+// Zero it before the first frame.
+typedef EventTimeline EventQueryTimeline;
+
+typedef struct EventQueryResult
+{
+	// Indexed by source or type when grouping, otherwise only groups[0]
+	// is used.
+	EventQueryStats groups[EVENT_QUERY_GROUPS];
+	// Frames that were broken off, badly escaped or the wrong size, and
+	// frames that don't carry the payload the schema gives them.
+	uint32_t badFrames;
+} EventQueryResult;
+
+// Sets up a query that matches every event.
+void eventQueryInit(EventQuery* query);
+
+void eventQueryOnlyLevel(EventQuery* query, EventLevel level);
+void eventQueryOnlySource(EventQuery* query, EventSource source);
+void eventQueryOnlyType(EventQuery* query, EventType type);
+
+// Applies the filters of a query to one frame.  Groups and aggregates are
+// ignored.  For the time filter, every frame of the stream must be passed
+// in order with the same timeline, whether or not it matches.
+bool eventQueryMatch(const EventQuery* query, EventQueryTimeline* timeline, const EventFrameView* view);
+
+// Runs a query over a capture buffer using up to nThreads threads.  The
+// buffer is cut into chunks at frame starts and each thread scans one.
+// With a time filter, each thread first follows the timestamps through its
+// chunk so that the next chunk knows the time it starts at.
+// Returns false if memory or threads couldn't be had; result is then
+// still safe to pass to eventQueryFree().
+bool eventQueryRun(const EventQuery* query, const char* data, size_t size, int nThreads, EventQueryResult* result);
+
+void eventQueryFree(EventQueryResult* result);
+
+// Mean of the numeric payloads in a group, or 0 if there were none.
+double eventQueryMean(const EventQueryResult* result, int group);
+
+// The given percentile (0 to 100) of the numeric payloads in a group.
+// Needs EventQuery.percentiles.  Returns 0 if the group has no values.
+double eventQueryPercentile(const EventQueryResult* result, int group, double percent);
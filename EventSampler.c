@@ -0,0 +1,357 @@
+/*
+* @file EventSampler.c
+*
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "EventSampler.h"
+
+static uint64_t nowMicros(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t threadNanos(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Reads a whole /proc file into the sampler's buffer.  Returns the
+// length, or -1.
+static int readStat(EventSampler* sampler, int fd)
+{
+    ssize_t n = pread(fd, sampler->buf, sizeof(sampler->buf) - 1, 0);
+
+    if (n <= 0)
+    {
+        return -1;
+    }
+    sampler->buf[n] = 0;
+    return (int)n;
+}
+
+// Parses utime + stime out of a stat line, and copies out the name if
+// name isn't NULL.  The name is in parentheses and may itself contain
+// spaces and parentheses, so fields are counted from the last ')'.
+static bool parseStat(const char* line, uint64_t* ticks, char* name, size_t nameSize)
+{
+    const char* open = strchr(line, '(');
+    const char* close = strrchr(line, ')');
+    const char* p;
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    int field = 2;
+
+    if (!open || !close || close < open)
+    {
+        return false;
+    }
+    if (name)
+    {
+        size_t len = (size_t)(close - open - 1);
+
+        if (len >= nameSize)
+        {
+            len = nameSize - 1;
+        }
+        memcpy(name, open + 1, len);
+        name[len] = 0;
+    }
+
+    // utime and stime are fields 14 and 15, counting from 1.
+    for (p = close + 1; *p && field < 13; p++)
+    {
+        if (*p == ' ')
+        {
+            field++;
+        }
+    }
+    if (field != 13)
+    {
+        return false;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        utime = utime * 10 + (uint64_t)(*p++ - '0');
+    }
+    if (*p++ != ' ')
+    {
+        return false;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        stime = stime * 10 + (uint64_t)(*p++ - '0');
+    }
+    *ticks = utime + stime;
+    return true;
+}
+
+// Hundredths of a percent of one CPU.
+static uint32_t usage(uint64_t cpuNanos, uint64_t wallMicros)
+{
+    if (wallMicros == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(cpuNanos * 10u / wallMicros);
+}
+
+static EventSource mappedSource(const EventSampler* sampler, const char* name)
+{
+    for (int i = 0; i < sampler->mapCount; i++)
+    {
+        if (strcmp(sampler->maps[i].name, name) == 0)
+        {
+            return sampler->maps[i].source;
+        }
+    }
+    return EVENT_SAMPLER_DISABLED;
+}
+
+static EventSamplerThread* findThread(EventSampler* sampler, int tid)
+{
+    for (int i = 0; i < sampler->threadCount; i++)
+    {
+        if (sampler->threads[i].tid == tid)
+        {
+            return &sampler->threads[i];
+        }
+    }
+    return NULL;
+}
+
+// Tick counts of mapped threads are summed per source, so a pool of
+// threads with one name is reported as one task.
+static void sampleTasks(EventSampler* sampler, uint64_t wallMicros, bool report)
+{
+    uint64_t delta[EVENT_SOURCE_COUNT] = { 0 };
+    bool mapped[EVENT_SOURCE_COUNT] = { false };
+    int dirFd = dirfd(sampler->taskDir);
+    struct dirent* entry;
+
+    for (int i = 0; i < sampler->threadCount; i++)
+    {
+        sampler->threads[i].seen = false;
+    }
+
+    rewinddir(sampler->taskDir);
+    while ((entry = readdir(sampler->taskDir)) != NULL)
+    {
+        char path[sizeof(entry->d_name) + 8];
+        char name[16];
+        EventSamplerThread* thread;
+        uint64_t ticks;
+        int tid = atoi(entry->d_name);
+        int fd;
+
+        if (tid <= 0)
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/stat", entry->d_name);
+        fd = openat(dirFd, path, O_RDONLY);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (readStat(sampler, fd) < 0 || !parseStat(sampler->buf, &ticks, name, sizeof(name)))
+        {
+            close(fd);
+            continue;
+        }
+        close(fd);
+
+        thread = findThread(sampler, tid);
+        if (!thread)
+        {
+            EventSource source = mappedSource(sampler, name);
+
+            if (source == EVENT_SAMPLER_DISABLED || sampler->threadCount == EVENT_SAMPLER_MAX_THREADS)
+            {
+                continue;
+            }
+            thread = &sampler->threads[sampler->threadCount++];
+            thread->tid = tid;
+            thread->source = source;
+            thread->ticks = ticks;
+        }
+        // A thread's name is looked up once, when it's first seen.
+        delta[thread->source] += ticks - thread->ticks;
+        mapped[thread->source] = true;
+        thread->ticks = ticks;
+        thread->seen = true;
+    }
+
+    // Forget threads that have exited.
+    for (int i = 0; i < sampler->threadCount; )
+    {
+        if (!sampler->threads[i].seen)
+        {
+            sampler->threads[i] = sampler->threads[--sampler->threadCount];
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (report)
+    {
+        uint64_t nanosPerTick = 1000000000u / (uint64_t)sampler->ticksPerSecond;
+
+        for (int source = 0; source < EVENT_SOURCE_COUNT; source++)
+        {
+            if (mapped[source])
+            {
+                eventLogU32(sampler->logger, EVENT_INFO, (EventSource)source, EVENT_TASK_USAGE,
+                    usage(delta[source] * nanosPerTick, wallMicros));
+            }
+        }
+    }
+}
+
+bool eventSamplerInit(EventSampler* sampler, EventLogger* logger, uint32_t periodMicros)
+{
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->logger = logger;
+    sampler->periodMicros = periodMicros;
+    sampler->processSource = EVENT_SOURCE_MAIN;
+    sampler->selfSource = EVENT_SOURCE_UNSPECIFIED;
+    sampler->ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (sampler->ticksPerSecond <= 0)
+    {
+        sampler->ticksPerSecond = 100;
+    }
+
+    sampler->procFd = open("/proc/self/stat", O_RDONLY);
+    sampler->taskDir = opendir("/proc/self/task");
+    if (sampler->procFd < 0 || !sampler->taskDir)
+    {
+        eventSamplerClose(sampler);
+        return false;
+    }
+    return true;
+}
+
+bool eventSamplerMapTask(EventSampler* sampler, const char* name, EventSource source)
+{
+    if (sampler->mapCount == EVENT_SAMPLER_MAX_MAPS || source >= EVENT_SOURCE_COUNT)
+    {
+        return false;
+    }
+    strncpy(sampler->maps[sampler->mapCount].name, name, sizeof(sampler->maps[0].name) - 1);
+    sampler->maps[sampler->mapCount].source = source;
+    sampler->mapCount++;
+    return true;
+}
+
+void eventSamplerSample(EventSampler* sampler)
+{
+    uint64_t startNanos = threadNanos();
+    uint64_t now = nowMicros();
+    uint64_t wall = now - sampler->lastMicros;
+    bool report = sampler->samples > 0;
+    uint64_t ticks;
+
+    if (readStat(sampler, sampler->procFd) >= 0 && parseStat(sampler->buf, &ticks, NULL, 0))
+    {
+        if (report && sampler->processSource != EVENT_SAMPLER_DISABLED)
+        {
+            uint64_t nanosPerTick = 1000000000u / (uint64_t)sampler->ticksPerSecond;
+
+            eventLogU32(sampler->logger, EVENT_INFO, sampler->processSource, EVENT_CPU_USAGE,
+                usage((ticks - sampler->processTicks) * nanosPerTick, wall));
+        }
+        sampler->processTicks = ticks;
+    }
+    sampleTasks(sampler, wall, report);
+
+    // The sampler's own time is measured precisely rather than in ticks,
+    // and covers up to the end of the previous sample.
+    if (report && sampler->selfSource != EVENT_SAMPLER_DISABLED)
+    {
+        eventLogU32(sampler->logger, EVENT_INFO, sampler->selfSource, EVENT_TASK_USAGE,
+            usage(sampler->selfNanos - sampler->lastSelfNanos, wall));
+    }
+    sampler->lastSelfNanos = sampler->selfNanos;
+    sampler->lastMicros = now;
+    sampler->samples++;
+    sampler->selfNanos += threadNanos() - startNanos;
+}
+
+static int samplerMain(void* arg)
+{
+    EventSampler* sampler = arg;
+
+    while (!atomic_load_explicit(&sampler->stop, memory_order_relaxed))
+    {
+        uint64_t start = nowMicros();
+        uint64_t spent;
+
+        eventSamplerSample(sampler);
+        spent = nowMicros() - start;
+        if (spent < sampler->periodMicros)
+        {
+            uint64_t wait = sampler->periodMicros - spent;
+            struct timespec ts = { (time_t)(wait / 1000000u), (long)(wait % 1000000u) * 1000 };
+
+            thrd_sleep(&ts, NULL);
+        }
+    }
+    return 0;
+}
+
+bool eventSamplerStart(EventSampler* sampler)
+{
+    if (sampler->running)
+    {
+        return true;
+    }
+    atomic_store(&sampler->stop, false);
+    sampler->running = thrd_create(&sampler->thread, samplerMain, sampler) == thrd_success;
+    return sampler->running;
+}
+
+void eventSamplerStop(EventSampler* sampler)
+{
+    if (!sampler->running)
+    {
+        return;
+    }
+    atomic_store(&sampler->stop, true);
+    thrd_join(sampler->thread, NULL);
+    sampler->running = false;
+}
+
+uint64_t eventSamplerSelfNanos(const EventSampler* sampler)
+{
+    return sampler->selfNanos;
+}
+
+void eventSamplerClose(EventSampler* sampler)
+{
+    eventSamplerStop(sampler);
+    if (sampler->procFd >= 0)
+    {
+        close(sampler->procFd);
+    }
+    if (sampler->taskDir)
+    {
+        closedir(sampler->taskDir);
+    }
+    sampler->procFd = -1;
+    sampler->taskDir = NULL;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+#include "EventLog.h"
+
+// Samples the CPU use of this process and its threads, for Linux hosts.
+//
+// A sampler thread reads /proc/self/stat and /proc/self/task/*/stat every
+// period and logs
+// - EVENT_CPU_USAGE on the process source, for the whole process
+// - EVENT_TASK_USAGE on each mapped source, for the threads whose names
+//   match it (see pthread_setname_np())
+// - EVENT_TASK_USAGE on the self source, for the sampler thread itself
+// each with a U32 payload in hundredths of a percent of one CPU since the
+// previous sample.  The kernel counts CPU time in clock ticks, usually
+// 10 ms, so short periods give coarse figures.
+//
+// The files are read into a fixed buffer and parsed by hand, and the task
+// directory is kept open and rewound, so a sample doesn't allocate.
+//
+// The sampler logs from its own thread.  Give it a logger of its own, or
+// one nobody else uses, whose sink is safe to call from that thread.
+//
+// For example,
+// static EventSampler sampler;
+// eventSamplerInit(&sampler, &logger, 1000000);
+// eventSamplerMapTask(&sampler, "nav", EVENT_SOURCE_3);
+// eventSamplerMapTask(&sampler, "gnc", EVENT_SOURCE_4);
+// eventSamplerStart(&sampler);
+// ...
+// eventSamplerStop(&sampler);
+
+#define EVENT_SAMPLER_MAX_MAPS 16
+#define EVENT_SAMPLER_MAX_THREADS 128
+#define EVENT_SAMPLER_DISABLED EVENT_SOURCE_COUNT
+
+typedef struct EventSamplerThread
+{
+	int tid;
+	EventSource source;
+	uint64_t ticks;
+	bool seen;
+} EventSamplerThread;
+
+typedef struct EventSampler
+{
+	EventLogger* logger;
+	uint32_t periodMicros;
+	EventSource processSource;    // or EVENT_SAMPLER_DISABLED
+	EventSource selfSource;       // or EVENT_SAMPLER_DISABLED
+
+	struct
+	{
+		char name[16];
+		EventSource source;
+	} maps[EVENT_SAMPLER_MAX_MAPS];
+	int mapCount;
+
+	EventSamplerThread threads[EVENT_SAMPLER_MAX_THREADS];
+	int threadCount;
+	uint64_t processTicks;
+	uint64_t lastMicros;
+	uint64_t selfNanos;           // sampler CPU time, all samples
+	uint64_t lastSelfNanos;       // as of the previous sample
+	uint32_t samples;
+	long ticksPerSecond;
+
+	int procFd;
+	DIR* taskDir;
+	char buf[512];
+
+	thrd_t thread;
+	atomic_bool stop;
+	bool running;
+} EventSampler;
+
+// Sets up a sampler that logs through logger every periodMicros.  The
+// process goes to EVENT_SOURCE_MAIN and the sampler itself to
+// EVENT_SOURCE_UNSPECIFIED; set processSource and selfSource to change
+// that.  Returns false if /proc can't be read.
+bool eventSamplerInit(EventSampler* sampler, EventLogger* logger, uint32_t periodMicros);
+
+// Reports threads named name on source.  Names are matched as the kernel
+// keeps them, cut to 15 characters.  Returns false if the table is full.
+bool eventSamplerMapTask(EventSampler* sampler, const char* name, EventSource source);
+
+// Takes one sample on the calling thread.  The first sample only sets the
+// baseline.
+void eventSamplerSample(EventSampler* sampler);
+
+// Starts and stops the sampler thread.
+bool eventSamplerStart(EventSampler* sampler);
+void eventSamplerStop(EventSampler* sampler);
+
+// CPU time the sampler has spent sampling, in nanoseconds.
+uint64_t eventSamplerSelfNanos(const EventSampler* sampler);
+
+// Closes the /proc files.  Stops the sampler thread if it's running.
+void eventSamplerClose(EventSampler* sampler);
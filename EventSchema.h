@@ -0,0 +1,122 @@
+#pragma once
+
+#include "EventLog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The event schema: every event the system emits, listed once.  Each
+// entry is
+//
+//   X(name, level, source, type, payload)
+//
+// where level is EVENT_INFO, EVENT_WARNING, EVENT_ERROR or EVENT_LEVEL_ANY,
+// and payload is one of NONE, BOOL, U8, S8, U16, S16, U32, S32, FLOAT or
+// STR.  From this list EventLog generates, for each entry with a fixed
+// level,
+//
+//   void event<name>(<payload type> val);
+//   void eventLog<name>(EventLogger* logger, <payload type> val);
+//
+// whose packet header is a compile-time constant, a decoder table that
+// rejects frames whose payload format doesn't match the schema, and the
+// names returned by eventSchemaName().
+//
+// For example, the entry
+//   X(MainVersion, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_VERSION, U32)
+// gives
+//   eventMainVersion(0x00010200);
+//
+// Events not listed here can still be sent with eventU16() and friends;
+// the decoder takes their payload format on trust.  A STOP listed with
+// payload NONE may also carry a U32, the elapsed time EVENT_SPAN_TIMED()
+// sends (see EventSpan.h).
+
+// The level of an event sent at a level chosen when it is emitted, such
+// as EVENT_SHED, which carries the level that lost events.  Such entries
+// are checked and named like the others but get no emitters.
+#define EVENT_LEVEL_ANY ((EventLevel)0xFF)
+
+#define EVENT_SCHEMA(X) \
+	X(MainVersion,  EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_VERSION,   U32) \
+	X(MainInit,     EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_INIT,      NONE) \
+	X(MainFini,     EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_FINI,      NONE) \
+	X(MainStart,    EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_START,     NONE) \
+	X(MainStop,     EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_STOP,      NONE) \
+	X(MainNewState, EVENT_INFO,      EVENT_SOURCE_MAIN,        EVENT_NEW_STATE, U8) \
+	X(Shed,         EVENT_LEVEL_ANY, EVENT_SOURCE_UNSPECIFIED, EVENT_SHED,      U32)
+
+// C types and argument lists for each payload kind.
+#define EVENT_SCHEMA_ARGS_NONE void
+#define EVENT_SCHEMA_ARGS_BOOL bool val
+#define EVENT_SCHEMA_ARGS_U8 uint8_t val
+#define EVENT_SCHEMA_ARGS_S8 int8_t val
+#define EVENT_SCHEMA_ARGS_U16 uint16_t val
+#define EVENT_SCHEMA_ARGS_S16 int16_t val
+#define EVENT_SCHEMA_ARGS_U32 uint32_t val
+#define EVENT_SCHEMA_ARGS_S32 int32_t val
+#define EVENT_SCHEMA_ARGS_FLOAT float val
+#define EVENT_SCHEMA_ARGS_STR const char* val
+
+#define EVENT_SCHEMA_LOGGER_ARGS_NONE
+#define EVENT_SCHEMA_LOGGER_ARGS_BOOL , bool val
+#define EVENT_SCHEMA_LOGGER_ARGS_U8 , uint8_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_S8 , int8_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_U16 , uint16_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_S16 , int16_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_U32 , uint32_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_S32 , int32_t val
+#define EVENT_SCHEMA_LOGGER_ARGS_FLOAT , float val
+#define EVENT_SCHEMA_LOGGER_ARGS_STR , const char* val
+
+#define EVENT_SCHEMA_DATA_TYPE_NONE EVENT_DATA_NONE
+#define EVENT_SCHEMA_DATA_TYPE_BOOL EVENT_DATA_BOOL
+#define EVENT_SCHEMA_DATA_TYPE_U8 EVENT_DATA_UINT8
+#define EVENT_SCHEMA_DATA_TYPE_S8 EVENT_DATA_INT8
+#define EVENT_SCHEMA_DATA_TYPE_U16 EVENT_DATA_UINT16
+#define EVENT_SCHEMA_DATA_TYPE_S16 EVENT_DATA_INT16
+#define EVENT_SCHEMA_DATA_TYPE_U32 EVENT_DATA_UINT32
+#define EVENT_SCHEMA_DATA_TYPE_S32 EVENT_DATA_INT32
+#define EVENT_SCHEMA_DATA_TYPE_FLOAT EVENT_DATA_FLOAT
+#define EVENT_SCHEMA_DATA_TYPE_STR EVENT_DATA_STRING
+
+// Expands to its arguments for entries with a fixed level only.
+#define EVENT_SCHEMA_IF_FIXED_EVENT_INFO(...) __VA_ARGS__
+#define EVENT_SCHEMA_IF_FIXED_EVENT_WARNING(...) __VA_ARGS__
+#define EVENT_SCHEMA_IF_FIXED_EVENT_ERROR(...) __VA_ARGS__
+#define EVENT_SCHEMA_IF_FIXED_EVENT_LEVEL_ANY(...)
+
+#define EVENT_SCHEMA_INDEX(name, level, source, type, payload) EVENT_SCHEMA_##name,
+typedef enum EventSchemaIndex {
+	EVENT_SCHEMA(EVENT_SCHEMA_INDEX)
+	EVENT_SCHEMA_COUNT
+} EventSchemaIndex;
+#undef EVENT_SCHEMA_INDEX
+
+typedef struct EventSchemaEntry
+{
+	const char* name;
+	EventLevel level;
+	EventSource source;
+	EventType type;
+	enum EventDataType dataType;
+} EventSchemaEntry;
+
+#define EVENT_SCHEMA_PROTOTYPES(name, level, source, type, payload) \
+	EVENT_SCHEMA_IF_FIXED_##level( \
+	void event##name(EVENT_SCHEMA_ARGS_##payload); \
+	void eventLog##name(EventLogger* logger EVENT_SCHEMA_LOGGER_ARGS_##payload);)
+EVENT_SCHEMA(EVENT_SCHEMA_PROTOTYPES)
+#undef EVENT_SCHEMA_PROTOTYPES
+
+// Returns the schema entry for a source and event ID, or NULL if the pair
+// isn't in the schema.
+const EventSchemaEntry* eventSchemaLookup(EventSource source, EventType type);
+
+// Returns the schema name of an event, such as "MainVersion", or NULL.
+const char* eventSchemaName(EventSource source, EventType type);
+
+#ifdef __cplusplus
+}
+#endif
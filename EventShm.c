@@ -0,0 +1,380 @@
+/*
+* @file EventShm.c
+*
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "EventShm.h"
+
+#define RING_MAGIC 0x45564C52u   // "EVLR"
+
+static EventShmProducer* itsOutputProducer;
+
+static uint64_t nowMicros(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint32_t roundUpPow2(uint32_t n)
+{
+    uint32_t p = 64;
+
+    while (p < n && p < 0x80000000u)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+static void copyName(char* dst, const char* src)
+{
+    strncpy(dst, src, 63);
+    dst[63] = 0;
+}
+
+// True if a timestamp comes before another, allowing for wraparound.
+static bool earlier(uint32_t a, uint32_t b)
+{
+    return ((a - b) & EVENT_TIMESTAMP_MASK) > (EVENT_TIMESTAMP_MASK >> 1);
+}
+
+bool eventShmProducerOpen(EventShmProducer* producer, const char* name, uint32_t capacity)
+{
+    EventShmRing* ring;
+    size_t mapSize;
+    int fd;
+
+    memset(producer, 0, sizeof(*producer));
+    capacity = roundUpPow2(capacity);
+    mapSize = sizeof(EventShmRing) + capacity;
+
+    fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (ftruncate(fd, (off_t)mapSize) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    ring = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // A collector checks the magic before anything else, so set it last.
+    ring->magic = 0;
+    atomic_thread_fence(memory_order_release);
+    ring->capacity = capacity;
+    ring->pid = (int32_t)getpid();
+    atomic_store_explicit(&ring->closed, false, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ring->magic = RING_MAGIC;
+
+    producer->ring = ring;
+    producer->mapSize = mapSize;
+    copyName(producer->name, name);
+    return true;
+}
+
+void eventShmProducerClose(EventShmProducer* producer)
+{
+    if (producer->ring)
+    {
+        atomic_store_explicit(&producer->ring->closed, true, memory_order_release);
+        munmap(producer->ring, producer->mapSize);
+    }
+    if (itsOutputProducer == producer)
+    {
+        itsOutputProducer = NULL;
+    }
+    memset(producer, 0, sizeof(*producer));
+}
+
+void eventShmSink(void* context, const char* buf, int len)
+{
+    EventShmProducer* producer = context;
+    EventShmRing* ring = producer->ring;
+    uint64_t head;
+    uint64_t tail;
+    uint32_t pos;
+    uint32_t first;
+
+    if (!ring || len <= 0)
+    {
+        return;
+    }
+
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (ring->capacity - (head - tail) < (uint64_t)len)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    pos = (uint32_t)head & (ring->capacity - 1);
+    first = ring->capacity - pos;
+    if (first > (uint32_t)len)
+    {
+        first = (uint32_t)len;
+    }
+    memcpy(ring->data + pos, buf, first);
+    memcpy(ring->data, buf + first, (uint32_t)len - first);
+
+    // Publish the whole frame at once.
+    atomic_store_explicit(&ring->head, head + (uint64_t)len, memory_order_release);
+}
+
+void eventShmOutput(const char* buf, int len)
+{
+    if (itsOutputProducer)
+    {
+        eventShmSink(itsOutputProducer, buf, len);
+    }
+}
+
+void eventShmSetOutputProducer(EventShmProducer* producer)
+{
+    itsOutputProducer = producer;
+}
+
+uint32_t eventShmBacklog(const EventShmProducer* producer)
+{
+    EventShmRing* ring = producer->ring;
+
+    if (!ring)
+    {
+        return 0;
+    }
+    return (uint32_t)(atomic_load_explicit(&ring->head, memory_order_relaxed) -
+        atomic_load_explicit(&ring->tail, memory_order_relaxed));
+}
+
+uint64_t eventShmDropped(const EventShmProducer* producer)
+{
+    return producer->ring ? atomic_load_explicit(&producer->ring->dropped, memory_order_relaxed) : 0;
+}
+
+void eventShmCollectorInit(EventShmCollector* collector)
+{
+    collector->count = 0;
+}
+
+bool eventShmCollectorAdd(EventShmCollector* collector, const char* name)
+{
+    EventShmSource* source;
+    EventShmRing* ring;
+    struct stat st;
+    int fd;
+
+    if (collector->count >= EVENT_SHM_MAX_RINGS)
+    {
+        return false;
+    }
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EventShmRing))
+    {
+        close(fd);
+        return false;
+    }
+    ring = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+    {
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (ring->magic != RING_MAGIC ||
+        sizeof(EventShmRing) + (size_t)ring->capacity > (size_t)st.st_size)
+    {
+        munmap(ring, (size_t)st.st_size);
+        return false;
+    }
+
+    source = &collector->sources[collector->count];
+    memset(source, 0, sizeof(*source));
+    source->ring = ring;
+    source->mapSize = (size_t)st.st_size;
+    copyName(source->name, name);
+    eventStreamInit(&source->stream);
+    source->lastData = nowMicros();
+    collector->count++;
+    return true;
+}
+
+// Pulls bytes from a ring until a whole frame is buffered or the ring is
+// empty.
+static bool fillSource(EventShmSource* source)
+{
+    EventShmRing* ring = source->ring;
+
+    while (!source->haveNext)
+    {
+        uint64_t head;
+        uint64_t tail;
+        uint32_t pos;
+        uint32_t n;
+        uint32_t first;
+        size_t room;
+        char* space;
+
+        if (eventStreamNext(&source->stream, &source->next))
+        {
+            source->haveNext = true;
+            break;
+        }
+
+        space = eventStreamSpace(&source->stream, &room);
+        head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        if (head == tail)
+        {
+            break;
+        }
+        n = (head - tail < room) ? (uint32_t)(head - tail) : (uint32_t)room;
+        pos = (uint32_t)tail & (ring->capacity - 1);
+        first = ring->capacity - pos;
+        if (first > n)
+        {
+            first = n;
+        }
+        memcpy(space, ring->data + pos, first);
+        memcpy(space + first, ring->data, n - first);
+        eventStreamCommit(&source->stream, n);
+        atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    }
+    return source->haveNext;
+}
+
+static bool producerGone(const EventShmRing* ring)
+{
+    if (atomic_load_explicit(&ring->closed, memory_order_acquire))
+    {
+        return true;
+    }
+    return kill((pid_t)ring->pid, 0) != 0 && errno == ESRCH;
+}
+
+int eventShmCollectorPoll(EventShmCollector* collector, uint32_t holdMicros, EventSinkFunc out, void* context)
+{
+    uint64_t now = nowMicros();
+    int emitted = 0;
+
+    for (int i = 0; i < collector->count; i++)
+    {
+        EventShmSource* source = &collector->sources[i];
+
+        if (source->done)
+        {
+            continue;
+        }
+        if (fillSource(source))
+        {
+            source->lastData = now;
+        }
+        else if (producerGone(source->ring) && !fillSource(source))
+        {
+            // Checked in this order so nothing written just before the
+            // producer went away is missed.
+            source->done = true;
+        }
+    }
+
+    for (;;)
+    {
+        EventShmSource* best = NULL;
+        uint32_t bestTime = 0;
+        bool blocked = false;
+
+        for (int i = 0; i < collector->count; i++)
+        {
+            EventShmSource* source = &collector->sources[i];
+
+            if (source->done)
+            {
+                continue;
+            }
+            if (!source->haveNext)
+            {
+                // This ring might still produce something earlier.
+                if (now - source->lastData < holdMicros)
+                {
+                    blocked = true;
+                }
+                continue;
+            }
+            {
+                uint32_t t = eventFrameTimestamp(&source->next);
+
+                if (!best || earlier(t, bestTime))
+                {
+                    best = source;
+                    bestTime = t;
+                }
+            }
+        }
+        if (!best || blocked)
+        {
+            break;
+        }
+
+        out(context, best->next.frame, best->next.frameSize);
+        best->haveNext = false;
+        emitted++;
+        if (fillSource(best))
+        {
+            best->lastData = now;
+        }
+    }
+    return emitted;
+}
+
+bool eventShmCollectorDone(const EventShmCollector* collector)
+{
+    for (int i = 0; i < collector->count; i++)
+    {
+        if (!collector->sources[i].done)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void eventShmCollectorClose(EventShmCollector* collector)
+{
+    for (int i = 0; i < collector->count; i++)
+    {
+        EventShmSource* source = &collector->sources[i];
+
+        munmap(source->ring, source->mapSize);
+        if (source->done)
+        {
+            shm_unlink(source->name);
+        }
+    }
+    collector->count = 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "EventLog.h"
+
+// Shared-memory transport between instrumented processes and one
+// collector, for POSIX hosts.
+//
+// Each producer owns a single-producer, single-consumer byte ring in a
+// POSIX shared memory object.  Sending a frame is a copy and a release
+// store: no locks and no system calls.  The write position is published
+// only after a whole frame is in the ring, so a producer that dies
+// mid-write leaves nothing half-written behind.  When the ring is full the
+// frame is dropped and counted.
+//
+// Only one thread may send to a ring at a time: two threads in
+// eventShmSink() on the same producer can claim the same space and
+// corrupt each other's frames.  Give each sending thread its own producer
+// and ring, or serialize the sends around the sink.
+//
+// The collector maps every ring, drains them and merges the frames into
+// one stream in timestamp order.  Producers on one host should share a
+// time base, such as eventClockMicros().
+//
+// For example, in each producer,
+// EventShmProducer shm;
+// eventShmProducerOpen(&shm, "/evlog-nav", 1 << 16);
+// eventLoggerSetSink(&logger, eventShmSink, &shm);
+//
+// and in the collector,
+// EventShmCollector col;
+// eventShmCollectorInit(&col);
+// eventShmCollectorAdd(&col, "/evlog-nav");
+// eventShmCollectorAdd(&col, "/evlog-gnc");
+// while (!eventShmCollectorDone(&col))
+//     eventShmCollectorPoll(&col, 10000, writeToCapture, file);
+
+#define EVENT_SHM_MAX_RINGS 32
+
+typedef struct EventShmRing
+{
+	uint32_t magic;
+	uint32_t capacity;    // bytes of data, a power of two
+	int32_t pid;          // of the producer
+	atomic_bool closed;   // set when the producer closes cleanly
+
+	// Bytes ever written and ever read.  Kept on their own cache lines
+	// so producer and consumer don't fight over them.
+	_Alignas(64) atomic_uint_fast64_t head;
+	_Alignas(64) atomic_uint_fast64_t tail;
+	_Alignas(64) atomic_uint_fast64_t dropped;
+
+	_Alignas(64) char data[];
+} EventShmRing;
+
+typedef struct EventShmProducer
+{
+	EventShmRing* ring;
+	size_t mapSize;
+	char name[64];
+} EventShmProducer;
+
+// Creates, or takes over, the shared memory object name (which must start
+// with '/') holding a ring of capacity bytes, rounded up to a power of
+// two.  Returns false on failure.
+bool eventShmProducerOpen(EventShmProducer* producer, const char* name, uint32_t capacity);
+
+// Marks the ring closed and unmaps it.  The collector removes it after
+// draining.
+void eventShmProducerClose(EventShmProducer* producer);
+
+// An EventSinkFunc.  The context is the EventShmProducer.  Not safe to
+// call from two threads on one producer.
+void eventShmSink(void* context, const char* buf, int len);
+
+// An EventOutputFunc writing to the producer given to
+// eventShmSetOutputProducer(), for eventSetOutputFunc().  The same
+// one-thread rule applies.
+void eventShmOutput(const char* buf, int len);
+void eventShmSetOutputProducer(EventShmProducer* producer);
+
+// Bytes waiting in the ring, for eventLoggerReportBacklog().
+uint32_t eventShmBacklog(const EventShmProducer* producer);
+
+// Frames dropped because the ring was full.
+uint64_t eventShmDropped(const EventShmProducer* producer);
+
+typedef struct EventShmSource
+{
+	EventShmRing* ring;
+	size_t mapSize;
+	char name[64];
+	EventStream stream;
+	EventFrameView next;
+	bool haveNext;
+	bool done;
+	// Wall-clock microseconds when this ring last had data.
+	uint64_t lastData;
+} EventShmSource;
+
+typedef struct EventShmCollector
+{
+	int count;
+	EventShmSource sources[EVENT_SHM_MAX_RINGS];
+} EventShmCollector;
+
+void eventShmCollectorInit(EventShmCollector* collector);
+
+// Maps an existing ring.  Returns false if it doesn't exist or isn't a
+// ring.
+bool eventShmCollectorAdd(EventShmCollector* collector, const char* name);
+
+// Drains every ring and passes frames to out in timestamp order.  A frame
+// is held back while some other live ring has nothing buffered, so that
+// ring can't later produce an earlier one, but for no more than holdMicros
+// of wall time.  Returns the number of frames passed on.
+int eventShmCollectorPoll(EventShmCollector* collector, uint32_t holdMicros, EventSinkFunc out, void* context);
+
+// True once every ring's producer has closed or died and its ring is
+// drained.
+bool eventShmCollectorDone(const EventShmCollector* collector);
+
+// Unmaps every ring and removes the shared memory objects of the ones that
+// are done.
+void eventShmCollectorClose(EventShmCollector* collector);
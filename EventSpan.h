@@ -0,0 +1,143 @@
+#pragma once
+
+#include "EventLog.h"
+
+// Scoped spans: EVENT_START when a scope is entered and EVENT_STOP when it
+// is left, however it is left.
+//
+// For example,
+// void taskIteration(void)
+// {
+//     EVENT_SPAN(EVENT_INFO, EVENT_SOURCE_3);
+//     if (!ready)
+//         return;            // EVENT_STOP still goes out
+//     ...
+// }
+//
+// EVENT_SPAN_TIMED() sends the time spent in the scope, in microseconds
+// of the logger's clock, as the U32 payload of the EVENT_STOP, which the
+// schema allows for STOPs it lists without a payload.
+// EVENT_SPAN_LOG() and EVENT_SPAN_LOG_TIMED() use a given logger instead
+// of the default one.
+//
+// Spans below EVENT_SPAN_MIN_LEVEL compile to nothing when the level is a
+// constant, logger expression included, and defining EVENT_SPANS_DISABLED
+// removes all of them.
+//
+// In C the spans use the GCC/Clang cleanup attribute.  In C++ they are
+// EventScopedSpan objects.
+
+// 0 = EVENT_INFO, 1 = EVENT_WARNING, 2 = EVENT_ERROR
+#ifndef EVENT_SPAN_MIN_LEVEL
+#define EVENT_SPAN_MIN_LEVEL 0
+#endif
+
+typedef struct EventSpan
+{
+	EventLogger* logger;
+	EventLevel level;
+	EventSource source;
+	bool timed;
+	uint32_t start;
+} EventSpan;
+
+static inline uint32_t eventSpanNow(EventLogger* logger)
+{
+	return logger->clock ? logger->clock(logger->clockContext) : 0;
+}
+
+static inline EventSpan eventSpanBegin(EventLogger* logger, EventLevel level, EventSource source, bool timed)
+{
+	EventSpan span = { 0 };
+
+	if ((int)level < EVENT_SPAN_MIN_LEVEL)
+	{
+		return span;
+	}
+	span.logger = logger;
+	span.level = level;
+	span.source = source;
+	span.timed = timed;
+	eventLog(logger, level, source, EVENT_START);
+	if (timed)
+	{
+		span.start = eventSpanNow(logger);
+	}
+	return span;
+}
+
+static inline void eventSpanEnd(EventSpan* span)
+{
+	if (!span->logger)
+	{
+		return;
+	}
+	if (span->timed)
+	{
+		uint32_t elapsed = (eventSpanNow(span->logger) - span->start) & EVENT_TIMESTAMP_MASK;
+
+		eventLogU32(span->logger, span->level, span->source, EVENT_STOP, elapsed);
+	}
+	else
+	{
+		eventLog(span->logger, span->level, span->source, EVENT_STOP);
+	}
+}
+
+// The logger, evaluated only for levels that aren't compiled out.
+#define EVENT_SPAN_LOGGER(logger, level) \
+	(((int)(level) < EVENT_SPAN_MIN_LEVEL) ? (EventLogger*)NULL : (logger))
+
+#define EVENT_SPAN_CONCAT2(a, b) a##b
+#define EVENT_SPAN_CONCAT(a, b) EVENT_SPAN_CONCAT2(a, b)
+#define EVENT_SPAN_VAR EVENT_SPAN_CONCAT(eventSpan_, __LINE__)
+
+#ifdef __cplusplus
+
+class EventScopedSpan
+{
+public:
+	EventScopedSpan(EventLogger* logger, EventLevel level, EventSource source, bool timed = false)
+		: itsSpan(eventSpanBegin(logger, level, source, timed))
+	{
+	}
+
+	~EventScopedSpan()
+	{
+		eventSpanEnd(&itsSpan);
+	}
+
+	EventScopedSpan(const EventScopedSpan&) = delete;
+	EventScopedSpan& operator=(const EventScopedSpan&) = delete;
+
+private:
+	EventSpan itsSpan;
+};
+
+#define EVENT_SPAN_DECLARE(logger, level, source, timed) \
+	EventScopedSpan EVENT_SPAN_VAR(EVENT_SPAN_LOGGER(logger, level), (level), (source), (timed))
+
+#elif defined(__GNUC__)
+
+#define EVENT_SPAN_DECLARE(logger, level, source, timed) \
+	EventSpan EVENT_SPAN_VAR __attribute__((cleanup(eventSpanEnd))) = \
+		eventSpanBegin(EVENT_SPAN_LOGGER(logger, level), (level), (source), (timed))
+
+#else
+
+#define EVENT_SPAN_DECLARE(logger, level, source, timed) \
+	_Static_assert(0, "EVENT_SPAN needs the GCC cleanup attribute in C; use C++ or emit START/STOP by hand")
+
+#endif
+
+#ifdef EVENT_SPANS_DISABLED
+#define EVENT_SPAN(level, source)
+#define EVENT_SPAN_TIMED(level, source)
+#define EVENT_SPAN_LOG(logger, level, source)
+#define EVENT_SPAN_LOG_TIMED(logger, level, source)
+#else
+#define EVENT_SPAN(level, source) EVENT_SPAN_DECLARE(eventDefaultLogger(), level, source, false)
+#define EVENT_SPAN_TIMED(level, source) EVENT_SPAN_DECLARE(eventDefaultLogger(), level, source, true)
+#define EVENT_SPAN_LOG(logger, level, source) EVENT_SPAN_DECLARE(logger, level, source, false)
+#define EVENT_SPAN_LOG_TIMED(logger, level, source) EVENT_SPAN_DECLARE(logger, level, source, true)
+#endif
@@ -0,0 +1,652 @@
+#include <stdint.h>
+#include <string.h>
+#include "EventCorrelate.h"
+#include "EventLog.h"
+#include "EventQuery.h"
+#include "EventSchema.h"
+#include "EventSpan.h"
+#include "UnitTest.h"
+#include "UnitTestRunner.h"
+
+#define CAPTURE_SIZE 4096
+#define MAX_EVENTS 64
+
+// What a logger under test sent, and the clock it reads.
+typedef struct Captured
+{
+	char buf[CAPTURE_SIZE];
+	int len;
+	uint32_t time;
+} Captured;
+
+static void captureSink(void* context, const char* buf, int len)
+{
+	Captured* captured = context;
+
+	if (captured->len + len <= CAPTURE_SIZE)
+	{
+		memcpy(captured->buf + captured->len, buf, (size_t)len);
+		captured->len += len;
+	}
+}
+
+static uint32_t captureClock(void* context)
+{
+	return ((Captured*)context)->time;
+}
+
+static void captureLogger(EventLogger* logger, Captured* captured)
+{
+	memset(captured, 0, sizeof(*captured));
+	eventLoggerInit(logger);
+	eventLoggerSetSink(logger, captureSink, captured);
+	eventLoggerSetClock(logger, captureClock, captured);
+}
+
+// Decodes every good frame captured.  Returns how many there were.
+static int decodeCaptured(const Captured* captured, EventData* events)
+{
+	EventFrameIter iter;
+	EventFrameView view;
+	int count = 0;
+
+	eventFrameIterInit(&iter, captured->buf, (size_t)captured->len);
+	while (count < MAX_EVENTS && eventFrameNext(&iter, &view))
+	{
+		events[count++] = eventFrameEvent(&view);
+	}
+	return count;
+}
+
+static void timedScope(EventLogger* logger, Captured* captured)
+{
+	EVENT_SPAN_LOG_TIMED(logger, EVENT_INFO, EVENT_SOURCE_MAIN);
+
+	captured->time += 250;
+}
+
+TEST(testSpanTimed)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	captured.time = 1000;
+	timedScope(&logger, &captured);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 2);
+	ASSERT_S32_EQUAL(events[0].eventID, EVENT_START);
+	ASSERT_TRUE(events[0].valid);
+	ASSERT_S32_EQUAL(events[1].eventID, EVENT_STOP);
+	ASSERT_TRUE(events[1].valid);
+	ASSERT_S32_EQUAL(events[1].dataType, EVENT_DATA_UINT32);
+	ASSERT_U32_EQUAL(events[1].data.u32, 250);
+}
+
+// A level beyond EVENT_ERROR, as four wire bits allow, has no lane and
+// goes straight to the sink.
+TEST(testLaneLevelOutOfRange)
+{
+	EventLogger logger;
+	Captured captured;
+	EventLaneSlot slots[4];
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetLane(&logger, EVENT_INFO, slots, 4, 1);
+	eventLoggerSetLane(&logger, (EventLevel)7, slots, 4, 1);
+	eventLog(&logger, (EventLevel)7, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 1);
+	ASSERT_S32_EQUAL(events[0].level, 7);
+	ASSERT_U32_EQUAL(eventLoggerLaneBacklog(&logger), 0);
+	ASSERT_TRUE(eventLoggerLaneStats(&logger, (EventLevel)7) == NULL);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, (EventLevel)7), 0);
+}
+
+// INFO is shed from half the backlog capacity and WARNING from three
+// quarters.  ERROR always gets through.
+TEST(testShedThresholds)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetBacklogCapacity(&logger, 400);
+
+	eventLoggerReportBacklog(&logger, 199);
+	eventLog(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLoggerReportBacklog(&logger, 200);
+	eventLog(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLog(&logger, EVENT_WARNING, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLoggerReportBacklog(&logger, 299);
+	eventLog(&logger, EVENT_WARNING, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLoggerReportBacklog(&logger, 300);
+	eventLog(&logger, EVENT_WARNING, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLog(&logger, EVENT_ERROR, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 4);
+	ASSERT_S32_EQUAL(events[0].level, EVENT_INFO);
+	ASSERT_S32_EQUAL(events[1].level, EVENT_WARNING);
+	ASSERT_S32_EQUAL(events[2].level, EVENT_WARNING);
+	ASSERT_S32_EQUAL(events[3].level, EVENT_ERROR);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, EVENT_INFO), 1);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, EVENT_WARNING), 1);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, EVENT_ERROR), 0);
+}
+
+// INFO stays shed until the backlog is below a quarter, and then one
+// EVENT_SHED per level goes out ahead of the first event let back in.
+TEST(testShedReportBeforeInfo)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetBacklogCapacity(&logger, 400);
+
+	eventLoggerReportBacklog(&logger, 300);
+	eventLog(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLog(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLog(&logger, EVENT_WARNING, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLog(&logger, EVENT_ERROR, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLoggerReportBacklog(&logger, 150);
+	eventLog(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC);
+	eventLoggerReportBacklog(&logger, 99);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, 7);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, 8);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 5);
+	ASSERT_S32_EQUAL(events[0].level, EVENT_ERROR);
+	ASSERT_S32_EQUAL(events[1].eventID, EVENT_SHED);
+	ASSERT_TRUE(events[1].valid);
+	ASSERT_S32_EQUAL(events[1].level, EVENT_INFO);
+	ASSERT_U32_EQUAL(events[1].data.u32, 3);
+	ASSERT_S32_EQUAL(events[2].eventID, EVENT_SHED);
+	ASSERT_S32_EQUAL(events[2].level, EVENT_WARNING);
+	ASSERT_U32_EQUAL(events[2].data.u32, 1);
+	ASSERT_U16_EQUAL(events[3].data.u16, 7);
+	ASSERT_U16_EQUAL(events[4].data.u16, 8);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, EVENT_INFO), 3);
+}
+
+// Logs one U32 whose timestamp and payload are full of framing bytes.
+static void logEscaped(EventLogger* logger, Captured* captured)
+{
+	captured->time = 0x5D1B5B;
+	eventLogU32(logger, EVENT_WARNING, EVENT_SOURCE_2, EVENT_GENERIC, 0x1B5B5D1B);
+}
+
+TEST(testFrameEscaped)
+{
+	EventLogger logger;
+	Captured captured;
+	EventFrameIter iter;
+	EventFrameView view;
+	EventData event;
+
+	captureLogger(&logger, &captured);
+	logEscaped(&logger, &captured);
+	// Seven bytes of the packet are escaped.
+	ASSERT_S32_EQUAL(captured.len, 2 + EVENT_PACKET_SIZE + 7);
+
+	eventFrameIterInit(&iter, captured.buf, (size_t)captured.len);
+	ASSERT_TRUE(eventFrameNext(&iter, &view));
+	ASSERT_S32_EQUAL(eventFrameLevel(&view), EVENT_WARNING);
+	ASSERT_S32_EQUAL(eventFrameSource(&view), EVENT_SOURCE_2);
+	ASSERT_U32_EQUAL(eventFrameTimestamp(&view), 0x5D1B5B);
+	ASSERT_U32_EQUAL(eventFramePayload(&view).u32, 0x1B5B5D1B);
+	ASSERT_FALSE(eventFrameNext(&iter, &view));
+	ASSERT_U32_EQUAL(iter.badFrames, 0);
+
+	event = eventUnpackFrame(captured.buf, captured.len);
+	ASSERT_TRUE(event.valid);
+	ASSERT_S32_EQUAL(event.frameSize, captured.len);
+	ASSERT_U32_EQUAL(event.timestamp, 0x5D1B5B);
+	ASSERT_U32_EQUAL(event.data.u32, 0x1B5B5D1B);
+}
+
+// A frame cut off by the end of the buffer is left for the next read, not
+// counted as bad.
+TEST(testFrameTruncated)
+{
+	EventLogger logger;
+	Captured captured;
+	EventFrameIter iter;
+	EventFrameView view;
+
+	captureLogger(&logger, &captured);
+	logEscaped(&logger, &captured);
+
+	eventFrameIterInit(&iter, captured.buf, (size_t)captured.len - 1);
+	ASSERT_FALSE(eventFrameNext(&iter, &view));
+	ASSERT_TRUE(iter.pos == captured.buf);
+	ASSERT_U32_EQUAL(iter.badFrames, 0);
+	ASSERT_FALSE(eventUnpackFrame(captured.buf, captured.len - 1).valid);
+}
+
+// A frame of the wrong size is skipped and counted; the next one is read.
+TEST(testFrameBadSkipped)
+{
+	EventLogger logger;
+	Captured captured;
+	EventFrameIter iter;
+	EventFrameView view;
+
+	captureLogger(&logger, &captured);
+	memcpy(captured.buf, "[abc]", 5);
+	captured.len = 5;
+	eventLogU8(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, 42);
+
+	eventFrameIterInit(&iter, captured.buf, (size_t)captured.len);
+	ASSERT_TRUE(eventFrameNext(&iter, &view));
+	ASSERT_U8_EQUAL(eventFramePayload(&view).u8, 42);
+	ASSERT_FALSE(eventFrameNext(&iter, &view));
+	ASSERT_U32_EQUAL(iter.badFrames, 1);
+}
+
+// A frame split across two reads comes out whole after the second.
+TEST(testStreamSplitFrame)
+{
+	EventLogger logger;
+	Captured captured;
+	EventStream stream;
+	EventFrameView view;
+	size_t room;
+	char* space;
+
+	captureLogger(&logger, &captured);
+	logEscaped(&logger, &captured);
+	eventStreamInit(&stream);
+
+	space = eventStreamSpace(&stream, &room);
+	memcpy(space, captured.buf, 10);
+	eventStreamCommit(&stream, 10);
+	ASSERT_FALSE(eventStreamNext(&stream, &view));
+
+	space = eventStreamSpace(&stream, &room);
+	memcpy(space, captured.buf + 10, (size_t)captured.len - 10);
+	eventStreamCommit(&stream, (size_t)captured.len - 10);
+	ASSERT_TRUE(eventStreamNext(&stream, &view));
+	ASSERT_U32_EQUAL(eventFrameEvent(&view).data.u32, 0x1B5B5D1B);
+	ASSERT_FALSE(eventStreamNext(&stream, &view));
+	ASSERT_U32_EQUAL(stream.badFrames, 0);
+}
+
+static void logRepeats(EventLogger* logger, Captured* captured, uint16_t val, int count, uint32_t step)
+{
+	for (int i = 0; i < count; i++)
+	{
+		captured->time += step;
+		eventLogU16(logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, val);
+	}
+}
+
+static void countExpanded(void* context, const EventData* event)
+{
+	(void)event;
+	(*(int*)context)++;
+}
+
+// A run of repeats becomes its first event and one EVENT_REPEATED with
+// the count, stamped with the last repeat.
+TEST(testRepeatCollapsed)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+	EventRepeatExpander expander;
+	int expanded = 0;
+	int count;
+
+	captureLogger(&logger, &captured);
+	eventLoggerCollapseRepeats(&logger, true, 0);
+	logRepeats(&logger, &captured, 7, 5, 10);
+	logRepeats(&logger, &captured, 9, 3, 10);
+	eventLoggerFlushRepeats(&logger);
+
+	count = decodeCaptured(&captured, events);
+	ASSERT_S32_EQUAL(count, 4);
+	ASSERT_U16_EQUAL(events[0].data.u16, 7);
+	ASSERT_U32_EQUAL(events[0].timestamp, 10);
+	ASSERT_S32_EQUAL(events[1].eventID, EVENT_REPEATED);
+	ASSERT_S32_EQUAL(events[1].sourceID, EVENT_SOURCE_1);
+	ASSERT_S32_EQUAL(events[1].level, EVENT_INFO);
+	ASSERT_U32_EQUAL(events[1].data.u32, 4);
+	ASSERT_U32_EQUAL(events[1].timestamp, 50);
+	ASSERT_U16_EQUAL(events[2].data.u16, 9);
+	ASSERT_S32_EQUAL(events[3].eventID, EVENT_REPEATED);
+	ASSERT_U32_EQUAL(events[3].data.u32, 2);
+	ASSERT_U32_EQUAL(events[3].timestamp, 80);
+
+	eventRepeatExpanderInit(&expander);
+	for (int i = 0; i < count; i++)
+	{
+		eventRepeatExpand(&expander, &events[i], countExpanded, &expanded);
+	}
+	ASSERT_S32_EQUAL(expanded, 8);
+}
+
+// A run longer than the window is reported every window.
+TEST(testRepeatWindow)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerCollapseRepeats(&logger, true, 100);
+	logRepeats(&logger, &captured, 7, 5, 50);
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 2);
+	ASSERT_U32_EQUAL(events[1].data.u32, 3);
+	ASSERT_U32_EQUAL(events[1].timestamp, 200);
+
+	eventLoggerFlushRepeats(&logger);
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 3);
+	ASSERT_S32_EQUAL(events[2].eventID, EVENT_REPEATED);
+	ASSERT_U32_EQUAL(events[2].data.u32, 1);
+	ASSERT_U32_EQUAL(events[2].timestamp, 250);
+}
+
+// Strict lanes send WARNING before INFO; ERROR has no lane and goes out
+// at once.
+TEST(testLaneStrict)
+{
+	EventLogger logger;
+	Captured captured;
+	EventLaneSlot infoSlots[4];
+	EventLaneSlot warningSlots[4];
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetLane(&logger, EVENT_INFO, infoSlots, 4, 1);
+	eventLoggerSetLane(&logger, EVENT_WARNING, warningSlots, 4, 1);
+	captured.time = 100;
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, 1);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, 2);
+	eventLogU16(&logger, EVENT_WARNING, EVENT_SOURCE_1, EVENT_GENERIC, 3);
+	eventLogU16(&logger, EVENT_ERROR, EVENT_SOURCE_1, EVENT_GENERIC, 4);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 1);
+	ASSERT_U16_EQUAL(events[0].data.u16, 4);
+	ASSERT_U32_GREATER_THAN(eventLoggerLaneBacklog(&logger), 0);
+
+	captured.time = 130;
+	ASSERT_S32_EQUAL(eventLoggerPump(&logger, 10), 3);
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 4);
+	ASSERT_U16_EQUAL(events[1].data.u16, 3);
+	ASSERT_U16_EQUAL(events[2].data.u16, 1);
+	ASSERT_U16_EQUAL(events[3].data.u16, 2);
+	ASSERT_U32_EQUAL(eventLoggerLaneBacklog(&logger), 0);
+	ASSERT_U32_EQUAL(eventLoggerLaneStats(&logger, EVENT_INFO)->sent, 2);
+	ASSERT_U32_EQUAL(eventLoggerLaneStats(&logger, EVENT_INFO)->latencyMax, 30);
+}
+
+// Weighted lanes take turns, each sending up to its weight.
+TEST(testLaneWeighted)
+{
+	EventLogger logger;
+	Captured captured;
+	EventLaneSlot infoSlots[4];
+	EventLaneSlot warningSlots[4];
+	EventData events[MAX_EVENTS];
+	static const uint16_t order[] = { 11, 1, 2, 12, 3, 4, 13 };
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetLane(&logger, EVENT_INFO, infoSlots, 4, 2);
+	eventLoggerSetLane(&logger, EVENT_WARNING, warningSlots, 4, 1);
+	eventLoggerSetLanePolicy(&logger, EVENT_LANES_WEIGHTED);
+	for (uint16_t i = 1; i <= 4; i++)
+	{
+		eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, i);
+	}
+	for (uint16_t i = 11; i <= 13; i++)
+	{
+		eventLogU16(&logger, EVENT_WARNING, EVENT_SOURCE_1, EVENT_GENERIC, i);
+	}
+
+	ASSERT_S32_EQUAL(eventLoggerPump(&logger, 10), 7);
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 7);
+	for (int i = 0; i < 7; i++)
+	{
+		ASSERT_U16_EQUAL(events[i].data.u16, order[i]);
+	}
+}
+
+// A frame that finds its lane full is dropped and reported by an
+// EVENT_SHED, which waits until the lane has room.
+TEST(testLaneFullShed)
+{
+	EventLogger logger;
+	Captured captured;
+	EventLaneSlot infoSlots[2];
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLoggerSetLane(&logger, EVENT_INFO, infoSlots, 2, 1);
+	for (uint16_t i = 1; i <= 3; i++)
+	{
+		eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC, i);
+	}
+	ASSERT_U32_EQUAL(eventLoggerLaneStats(&logger, EVENT_INFO)->dropped, 1);
+	ASSERT_U32_EQUAL(eventLoggerShedCount(&logger, EVENT_INFO), 1);
+
+	ASSERT_S32_EQUAL(eventLoggerPump(&logger, 10), 2);
+	eventLogU16(&logger, EVENT_ERROR, EVENT_SOURCE_1, EVENT_GENERIC, 9);
+	ASSERT_S32_EQUAL(eventLoggerPump(&logger, 10), 1);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 4);
+	ASSERT_U16_EQUAL(events[0].data.u16, 1);
+	ASSERT_U16_EQUAL(events[1].data.u16, 2);
+	ASSERT_U16_EQUAL(events[2].data.u16, 9);
+	ASSERT_S32_EQUAL(events[3].eventID, EVENT_SHED);
+	ASSERT_S32_EQUAL(events[3].level, EVENT_INFO);
+	ASSERT_U32_EQUAL(events[3].data.u32, 1);
+}
+
+
+#define QUERY_EVENTS 20000
+#define QUERY_STEP 4096
+
+// Big enough for eventQueryRun() to split it across threads.
+typedef struct QueryCapture
+{
+	char buf[QUERY_EVENTS * EVENT_FRAME_SIZE_MAX];
+	size_t len;
+	uint32_t time;
+} QueryCapture;
+
+static void querySink(void* context, const char* buf, int len)
+{
+	QueryCapture* capture = context;
+
+	memcpy(capture->buf + capture->len, buf, (size_t)len);
+	capture->len += (size_t)len;
+}
+
+static uint32_t queryClock(void* context)
+{
+	return ((QueryCapture*)context)->time;
+}
+
+// Events QUERY_STEP apart roll the timestamp over about every 4096, and
+// time windows are given in unwrapped time.
+TEST(testQueryRollover)
+{
+	static QueryCapture capture;
+	EventLogger logger;
+	EventQuery query;
+	EventQueryResult result;
+
+	capture.len = 0;
+	eventLoggerInit(&logger);
+	eventLoggerSetSink(&logger, querySink, &capture);
+	eventLoggerSetClock(&logger, queryClock, &capture);
+	for (uint32_t i = 0; i < QUERY_EVENTS; i++)
+	{
+		capture.time = (i * QUERY_STEP) & EVENT_TIMESTAMP_MASK;
+		eventLogU16(&logger, EVENT_INFO, (i % 2) ? EVENT_SOURCE_1 : EVENT_SOURCE_2, EVENT_GENERIC, (uint16_t)i);
+	}
+
+	// Ten events either side of the first rollover.
+	eventQueryInit(&query);
+	query.timeFilter = true;
+	query.timeMin = (1 << EVENT_TIMESTAMP_BITS) - 10 * QUERY_STEP;
+	query.timeMax = (1 << EVENT_TIMESTAMP_BITS) + 10 * QUERY_STEP;
+	for (int threads = 1; threads <= 4; threads *= 2)
+	{
+		ASSERT_TRUE(eventQueryRun(&query, capture.buf, capture.len, threads, &result));
+		ASSERT_U32_EQUAL(result.groups[0].count, 21);
+		ASSERT_U32_EQUAL(result.badFrames, 0);
+		eventQueryFree(&result);
+	}
+
+	// A hundred events four rollovers in, half of them from source 1.
+	query.timeMin = (int64_t)4 << EVENT_TIMESTAMP_BITS;
+	query.timeMax = query.timeMin + 99 * QUERY_STEP;
+	eventQueryOnlySource(&query, EVENT_SOURCE_1);
+	ASSERT_TRUE(eventQueryRun(&query, capture.buf, capture.len, 4, &result));
+	ASSERT_U32_EQUAL(result.groups[0].count, 50);
+	eventQueryFree(&result);
+}
+
+// A frame whose payload breaks the schema is counted as bad, not matched.
+TEST(testQuerySkipsInvalid)
+{
+	EventLogger logger;
+	Captured captured;
+	EventQuery query;
+	EventQueryResult result;
+
+	captureLogger(&logger, &captured);
+	eventLogU8(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_NEW_STATE, 1);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_NEW_STATE, 2);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_SEND, 3);
+
+	eventQueryInit(&query);
+	ASSERT_TRUE(eventQueryRun(&query, captured.buf, (size_t)captured.len, 1, &result));
+	ASSERT_U32_EQUAL(result.groups[0].count, 2);
+	ASSERT_U32_EQUAL(result.badFrames, 1);
+	eventQueryFree(&result);
+}
+
+
+static void correlate(EventCorrelator* corr, EventSource source, EventType type, uint16_t id, uint32_t time)
+{
+	EventData event = { 0 };
+
+	event.valid = true;
+	event.sourceID = source;
+	event.eventID = type;
+	event.timestamp = time;
+	event.dataType = EVENT_DATA_UINT16;
+	event.data.u16 = id;
+	eventCorrelatorAdd(corr, &event);
+}
+
+// Messages from source 1 to source 2 with a 1000 us window: three
+// matched, one received twice, one resent, one lost and one receive of
+// a message never sent.
+TEST(testCorrelate)
+{
+	EventCorrelator corr;
+	const EventRouteStats* route;
+	const EventSenderStats* sender;
+
+	ASSERT_TRUE(eventCorrelatorInit(&corr, 64, 1000));
+	correlate(&corr, EVENT_SOURCE_1, EVENT_SEND, 1, 0);
+	correlate(&corr, EVENT_SOURCE_2, EVENT_RECEIVE, 1, 100);
+	correlate(&corr, EVENT_SOURCE_1, EVENT_SEND, 2, 200);
+	correlate(&corr, EVENT_SOURCE_2, EVENT_RECEIVE, 2, 450);
+	correlate(&corr, EVENT_SOURCE_2, EVENT_RECEIVE, 2, 500);
+	correlate(&corr, EVENT_SOURCE_1, EVENT_SEND, 3, 600);
+	correlate(&corr, EVENT_SOURCE_2, EVENT_RECEIVE, 9, 700);
+	correlate(&corr, EVENT_SOURCE_1, EVENT_SEND, 4, 800);
+	correlate(&corr, EVENT_SOURCE_1, EVENT_SEND, 4, 850);
+	correlate(&corr, EVENT_SOURCE_2, EVENT_RECEIVE, 4, 900);
+	// Any event moves the clock on, and message 3 out of its window.
+	correlate(&corr, EVENT_SOURCE_1, EVENT_GENERIC, 0, 2000);
+
+	route = &corr.routes[EVENT_SOURCE_1][EVENT_SOURCE_2];
+	sender = &corr.senders[EVENT_SOURCE_1];
+	ASSERT_U32_EQUAL(sender->lost, 1);
+	eventCorrelatorFinish(&corr);
+
+	ASSERT_U32_EQUAL(route->matched, 3);
+	ASSERT_U32_EQUAL(route->duplicates, 1);
+	ASSERT_U32_EQUAL(route->reordered, 0);
+	ASSERT_U32_EQUAL(route->latencyMin, 50);
+	ASSERT_U32_EQUAL(route->latencyMax, 250);
+	ASSERT_U32_EQUAL(route->latencySum, 400);
+	ASSERT_U32_EQUAL(sender->sent, 5);
+	ASSERT_U32_EQUAL(sender->resent, 1);
+	ASSERT_U32_EQUAL(sender->lost, 1);
+	ASSERT_U32_EQUAL(corr.orphans, 1);
+	eventCorrelatorFree(&corr);
+}
+
+
+// Loggers share nothing: the filters and clock of one don't touch another.
+TEST(testLoggersIndependent)
+{
+	EventLogger first;
+	EventLogger second;
+	Captured firstCaptured;
+	Captured secondCaptured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&first, &firstCaptured);
+	captureLogger(&second, &secondCaptured);
+	firstCaptured.time = 5;
+	secondCaptured.time = 9;
+	eventLoggerSetMinLevel(&first, EVENT_WARNING);
+	eventLoggerEnableSource(&second, EVENT_SOURCE_1, false);
+
+	eventLog(&first, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC);
+	eventLog(&first, EVENT_WARNING, EVENT_SOURCE_1, EVENT_GENERIC);
+	eventLog(&first, EVENT_INFO, EVENT_SOURCE_2, EVENT_GENERIC);
+	eventLog(&second, EVENT_INFO, EVENT_SOURCE_1, EVENT_GENERIC);
+	eventLog(&second, EVENT_WARNING, EVENT_SOURCE_1, EVENT_GENERIC);
+	eventLog(&second, EVENT_INFO, EVENT_SOURCE_2, EVENT_GENERIC);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&firstCaptured, events), 1);
+	ASSERT_S32_EQUAL(events[0].level, EVENT_WARNING);
+	ASSERT_S32_EQUAL(events[0].sourceID, EVENT_SOURCE_1);
+	ASSERT_U32_EQUAL(events[0].timestamp, 5);
+	ASSERT_S32_EQUAL(decodeCaptured(&secondCaptured, events), 1);
+	ASSERT_S32_EQUAL(events[0].level, EVENT_INFO);
+	ASSERT_S32_EQUAL(events[0].sourceID, EVENT_SOURCE_2);
+	ASSERT_U32_EQUAL(events[0].timestamp, 9);
+}
+
+
+// A generated emitter fills in the header the schema gives.  The decoder
+// rejects a payload the schema doesn't give and trusts events it doesn't
+// list.
+TEST(testSchemaEmitters)
+{
+	EventLogger logger;
+	Captured captured;
+	EventData events[MAX_EVENTS];
+
+	captureLogger(&logger, &captured);
+	eventLogMainNewState(&logger, 3);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_NEW_STATE, 3);
+	eventLogU16(&logger, EVENT_INFO, EVENT_SOURCE_1, EVENT_NEW_STATE, 3);
+
+	ASSERT_S32_EQUAL(decodeCaptured(&captured, events), 3);
+	ASSERT_TRUE(events[0].valid);
+	ASSERT_S32_EQUAL(events[0].level, EVENT_INFO);
+	ASSERT_S32_EQUAL(events[0].sourceID, EVENT_SOURCE_MAIN);
+	ASSERT_S32_EQUAL(events[0].eventID, EVENT_NEW_STATE);
+	ASSERT_S32_EQUAL(events[0].dataType, EVENT_DATA_UINT8);
+	ASSERT_U8_EQUAL(events[0].data.u8, 3);
+	ASSERT_FALSE(events[1].valid);
+	ASSERT_TRUE(events[2].valid);
+
+	ASSERT_STR_EQUAL(eventSchemaName(EVENT_SOURCE_MAIN, EVENT_NEW_STATE), "MainNewState");
+	ASSERT_TRUE(eventSchemaName(EVENT_SOURCE_1, EVENT_NEW_STATE) == NULL);
+}
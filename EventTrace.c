@@ -0,0 +1,96 @@
+/*
+* @file EventTrace.c
+*
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "EventTrace.h"
+
+#define MARKER_PREFIX "evlog "
+
+static EventTraceMarker* itsOutputMarker;
+
+bool eventTraceMarkerOpen(EventTraceMarker* marker, bool raw)
+{
+    static const char* const dirs[] = { "/sys/kernel/tracing/", "/sys/kernel/debug/tracing/" };
+    const char* file = raw ? "trace_marker_raw" : "trace_marker";
+
+    marker->raw = raw;
+    marker->dropped = 0;
+    marker->fd = -1;
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]) && marker->fd < 0; i++)
+    {
+        char path[64];
+
+        strcpy(path, dirs[i]);
+        strcat(path, file);
+        marker->fd = open(path, O_WRONLY | O_CLOEXEC);
+    }
+    return marker->fd >= 0;
+}
+
+void eventTraceMarkerClose(EventTraceMarker* marker)
+{
+    if (marker->fd >= 0)
+    {
+        close(marker->fd);
+    }
+    marker->fd = -1;
+}
+
+void eventTraceSink(void* context, const char* buf, int len)
+{
+    EventTraceMarker* marker = context;
+    EventFrameIter iter;
+    EventFrameView view;
+
+    if (marker->fd < 0)
+    {
+        return;
+    }
+    eventFrameIterInit(&iter, buf, (size_t)len);
+    while (eventFrameNext(&iter, &view))
+    {
+        if (marker->raw)
+        {
+            char record[sizeof(uint32_t) + EVENT_PACKET_SIZE];
+            uint32_t id = EVENT_TRACE_RAW_ID;
+
+            memcpy(record, &id, sizeof(id));
+            memcpy(record + sizeof(id), view.packet, EVENT_PACKET_SIZE);
+            if (write(marker->fd, record, sizeof(record)) < 0)
+            {
+                marker->dropped++;
+            }
+        }
+        else
+        {
+            char line[sizeof(MARKER_PREFIX) + EVENT_FORMAT_MAX];
+            EventData event = eventFrameEvent(&view);
+            int n = eventFormat(&event, line + sizeof(MARKER_PREFIX) - 1, EVENT_FORMAT_MAX);
+
+            memcpy(line, MARKER_PREFIX, sizeof(MARKER_PREFIX) - 1);
+            if (write(marker->fd, line, sizeof(MARKER_PREFIX) - 1 + (size_t)n) < 0)
+            {
+                marker->dropped++;
+            }
+        }
+    }
+}
+
+void eventTraceOutput(const char* buf, int len)
+{
+    if (itsOutputMarker)
+    {
+        eventTraceSink(itsOutputMarker, buf, len);
+    }
+}
+
+void eventTraceSetOutputMarker(EventTraceMarker* marker)
+{
+    itsOutputMarker = marker;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "EventLog.h"
+
+// Writes events into the Linux ftrace buffer, next to scheduler and
+// syscall events, for viewing with trace-cmd, perf or Perfetto.
+//
+// In text mode each event is one write() of a line to trace_marker, such
+// as
+//   evlog 00123456 INFO 3 START
+// In raw mode each event is one write() to trace_marker_raw of a 32-bit
+// EVENT_TRACE_RAW_ID followed by the 12-byte packet, for tools that
+// decode binary records.  Either way the kernel stamps the record with its
+// own clock.
+//
+// Writing needs permission on tracefs, usually root or the tracing group.
+//
+// For example,
+// EventTraceMarker marker;
+// if (eventTraceMarkerOpen(&marker, false))
+//     eventLoggerSetSink(&logger, eventTraceSink, &marker);
+//
+// eventtrace.c turns captures into Chrome/Perfetto JSON instead.
+
+#define EVENT_TRACE_RAW_ID 0x45564C47u   // "EVLG"
+
+typedef struct EventTraceMarker
+{
+	int fd;
+	bool raw;
+	uint32_t dropped;    // records the kernel refused
+} EventTraceMarker;
+
+// Opens trace_marker, or trace_marker_raw if raw, under /sys/kernel/tracing
+// or /sys/kernel/debug/tracing.  Returns false if neither can be opened.
+bool eventTraceMarkerOpen(EventTraceMarker* marker, bool raw);
+
+void eventTraceMarkerClose(EventTraceMarker* marker);
+
+// An EventSinkFunc.  The context is the EventTraceMarker.
+void eventTraceSink(void* context, const char* buf, int len);
+
+// An EventOutputFunc writing to the marker given to
+// eventTraceSetOutputMarker(), for eventSetOutputFunc().
+void eventTraceOutput(const char* buf, int len);
+void eventTraceSetOutputMarker(EventTraceMarker* marker);
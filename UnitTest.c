@@ -5,151 +5,799 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
-#include <Windows.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 #include "UnitTest.h"
+#include "UnitTestRunner.h"
 
-#define ENTRIES_COUNT 120
+// Results go into a log of fixed-size chunks, allocated as the log grows
+// and freed once read, so nothing is lost however many results a suite
+// records and there is no malloc per result.
+#define CHUNK_ENTRIES 256
 
-static int32_t itsPassCount;
-static int32_t itsFailCount;
-static UnitTestOutput itsOutputStore[ENTRIES_COUNT];
-static int16_t itsEntryHead;
-static int16_t itsEntryTail;
-static HANDLE itsMtx;
+// Distinct strings kept by internString().  Past this, string operands
+// and messages are copied for each result instead.
+#define INTERN_SLOTS 4096
+#define INTERN_PROBES 32
+
+// Assertions record their operands, not a message: the message is only
+// formatted when unitTestGetEntry() hands the entry out, so passing
+// assertions in a loop cost a few stores.  Names are the static strings
+// from the ASSERT macros and are kept as pointers; string operands and
+// messages may not outlive the call, so they are interned.
+
+typedef enum AssertKind
+{
+    KIND_MESSAGE,
+    KIND_TRUE,
+    KIND_FALSE,
+    KIND_S8,
+    KIND_U8,
+    KIND_S16,
+    KIND_U16,
+    KIND_S32,
+    KIND_U32,
+    KIND_F32,
+    KIND_F64,
+    KIND_STR,
+    KIND_MEM
+} AssertKind;
+
+typedef enum AssertOp
+{
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_LESS_THAN,
+    OP_GREATER_THAN,
+    OP_LESS_THAN_OR_EQUAL,
+    OP_GREATER_THAN_OR_EQUAL
+} AssertOp;
+
+static const char* const itsOpNames[] = { "==", "!=", "<", ">", "<=", ">=" };
+
+typedef union AssertValue
+{
+    int32_t s;
+    uint32_t u;
+    double f;
+    const char* str;
+} AssertValue;
+
+typedef struct RawEntry
+{
+    atomic_uchar ready;
+    uint8_t result;
+    uint8_t kind;
+    uint8_t op;
+    // Bit 0 and 1: a.str and b.str are copies of our own to free.
+    uint8_t owned;
+    int line;
+    const char* func;
+    const char* aName;
+    const char* bName;
+    AssertValue a;
+    AssertValue b;
+} RawEntry;
+
+typedef struct Chunk
+{
+    _Atomic(struct Chunk*) next;
+    struct Chunk* retiredNext;
+    atomic_uint claimed;
+    RawEntry entries[CHUNK_ENTRIES];
+} Chunk;
+
+// Results captured on one thread, kept out of the shared log until
+// committed.  Only the capturing thread writes it.
+struct UnitTestCapture
+{
+    Chunk* first;
+    Chunk* last;
+    unsigned lastCount;
+    // The capture that was current when this one began.
+    UnitTestCapture* outer;
+};
+
+static _Thread_local UnitTestCapture* itsCapture;
+
+// Producers claim entries in the tail chunk with a fetch-and-add, and the
+// one that overflows it links on the next chunk.  Neither takes a lock.
+// The single consumer reads from the head chunk and retires each chunk
+// once it has been read and is no longer the tail.  A retired chunk may
+// still be referenced by a producer that loaded the tail before it moved
+// on, so chunks are only freed at a moment when no producer is inside
+// claimEntry()...publishEntry().  The first chunk is static and never
+// freed.
+static Chunk itsFirstChunk;
+static _Atomic(Chunk*) itsTail = &itsFirstChunk;
+static atomic_int itsActiveWriters;
+static Chunk* itsHead = &itsFirstChunk;
+static uint32_t itsReadIndex;
+static Chunk* itsRetired;
+
+// One reader at a time: unitTestGetEntry(), or a producer streaming to the
+// reporter at the memory cap.
+static atomic_flag itsReading = ATOMIC_FLAG_INIT;
+
+static atomic_size_t itsBytesInUse;
+static size_t itsMemoryCap;
+static UnitTestReporter itsReporter;
+static void* itsReporterContext;
+
+static _Atomic(const char*) itsInterned[INTERN_SLOTS];
+
+static atomic_int_least32_t itsPassCount;
+static atomic_int_least32_t itsFailCount;
+static atomic_uint_fast32_t itsDropped;
 
 // When true, add passing entries to table
 static bool itsVerbose;
 
-// Initialize the mutex that guards this module
-static bool initMutex(void);
+// malloc() and calloc() for the harness's own memory, which the runner
+// doesn't count against the test that caused it.
+static void* harnessMalloc(size_t size)
+{
+    void* ptr;
 
-static void addEntry(UnitTestResult result, const char* name, int line, const char* msg);
+    unitTestAllocHarnessBegin();
+    ptr = malloc(size);
+    unitTestAllocHarnessEnd();
+    return ptr;
+}
 
-// Creates a mutex.  On success it returns true. Otherwise false.
-static bool initMutex(void)
+static void* harnessCalloc(size_t count, size_t size)
 {
-	itsMtx = CreateMutex(NULL, FALSE, NULL);  // Initially unowned
-	if (!itsMtx)
-	{
-		printf("CreateMutex error: %d\n", GetLastError());
-        return false;
-	}
-    return true;
-}
+    void* ptr;
 
-// If there is room in the output store, this adds an entry to the output store.
-// If the output store is full, it toggles the overflow flag in the most recently
-// added message.
+    unitTestAllocHarnessBegin();
+    ptr = calloc(count, size);
+    unitTestAllocHarnessEnd();
+    return ptr;
+}
 
-static void addEntry(UnitTestResult result, const char* name, int line, const char* msg)
+// Returns the one shared copy of str, made on first use.  Returns NULL if
+// the table is full or out of memory.
+static const char* internString(const char* str)
 {
-    DWORD waitResult;
+    uint32_t hash = 2166136261u;
+    size_t len = strlen(str);
+    char* copy = NULL;
 
-    // Since integers are atomic, this doesn't need a mutex
-    if (result == UNIT_TEST_PASS)
+    for (size_t i = 0; i < len; i++)
     {
-        itsPassCount++;
+        hash = (hash ^ (uint8_t)str[i]) * 16777619u;
     }
-    else if (result == UNIT_TEST_FAIL)
+    for (uint32_t probe = 0; probe < INTERN_PROBES; probe++)
     {
-        itsFailCount++;
+        _Atomic(const char*)* slot = &itsInterned[(hash + probe) % INTERN_SLOTS];
+        const char* found = atomic_load_explicit(slot, memory_order_acquire);
+
+        if (!found)
+        {
+            if (!copy)
+            {
+                copy = harnessMalloc(len + 1);
+                if (!copy)
+                {
+                    return NULL;
+                }
+                memcpy(copy, str, len + 1);
+            }
+            if (atomic_compare_exchange_strong_explicit(slot, &found, copy, memory_order_acq_rel, memory_order_acquire))
+            {
+                return copy;
+            }
+            // Another thread filled the slot first; found is its string.
+        }
+        if (strcmp(found, str) == 0)
+        {
+            free(copy);
+            return found;
+        }
     }
-    else
+    free(copy);
+    return NULL;
+}
+
+// Interns str, or copies it for this entry alone.  Sets bit in *owned for
+// a copy.
+static const char* keepString(const char* str, uint8_t* owned, uint8_t bit)
+{
+    const char* kept = internString(str);
+
+    if (!kept)
     {
-        ;  // Shouldn't happen
+        size_t len = strlen(str);
+        char* copy = harnessMalloc(len + 1);
+
+        if (copy)
+        {
+            memcpy(copy, str, len + 1);
+            *owned |= bit;
+        }
+        kept = copy ? copy : "";
     }
+    return kept;
+}
+
+static Chunk* newChunk(void)
+{
+    Chunk* chunk = harnessCalloc(1, sizeof(Chunk));
 
-    if (!itsMtx)
+    if (chunk)
     {
-        initMutex();
+        atomic_fetch_add_explicit(&itsBytesInUse, sizeof(Chunk), memory_order_relaxed);
     }
+    return chunk;
+}
+
+static void freeRetiredChunks(int writersOfOurOwn);
+static void streamToReporter(void);
+
+// Claims an entry in the shared log.  Returns NULL, and counts the entry
+// as dropped, only if out of memory; the consumer then flags the last
+// entry it reads as having overflowed.
+static RawEntry* claimSharedEntry(void)
+{
+    Chunk* chunk;
+    unsigned index;
 
-    if (itsMtx)
+    atomic_fetch_add(&itsActiveWriters, 1);
+    chunk = atomic_load(&itsTail);
+    for (;;)
     {
-        waitResult = WaitForSingleObject(itsMtx, INFINITE);
-        if (waitResult == WAIT_OBJECT_0)
+        Chunk* next;
+
+        index = atomic_fetch_add_explicit(&chunk->claimed, 1, memory_order_relaxed);
+        if (index < CHUNK_ENTRIES)
         {
-            if (((itsEntryTail + 1) % ENTRIES_COUNT) == itsEntryHead)
+            break;
+        }
+
+        // Full: link on the next chunk, or use the one another producer
+        // linked, and help move the tail to it.
+        next = atomic_load_explicit(&chunk->next, memory_order_acquire);
+        if (!next)
+        {
+            Chunk* fresh = newChunk();
+
+            if (!fresh)
+            {
+                atomic_fetch_add_explicit(&itsDropped, 1, memory_order_relaxed);
+                atomic_fetch_sub(&itsActiveWriters, 1);
+                return NULL;
+            }
+            if (atomic_compare_exchange_strong(&chunk->next, &next, fresh))
             {
-                itsOutputStore[itsEntryTail].overflow = true;
+                next = fresh;
             }
             else
             {
-                itsOutputStore[itsEntryTail].overflow = false;
-                itsOutputStore[itsEntryTail].result = result;
-                itsOutputStore[itsEntryTail].line = line;
-                strncpy(itsOutputStore[itsEntryTail].name, name, UNIT_TEST_FUNC_NAME_LEN);
-                strncpy(itsOutputStore[itsEntryTail].msg, msg, UNIT_TEST_MESSAGE_LEN);
-                itsEntryTail++;
-                if (itsEntryTail >= ENTRIES_COUNT)
-                {
-                    itsEntryTail = 0;
-                }
+                atomic_fetch_sub_explicit(&itsBytesInUse, sizeof(Chunk), memory_order_relaxed);
+                free(fresh);
             }
+        }
+        atomic_compare_exchange_strong(&itsTail, &chunk, next);
+        chunk = atomic_load(&itsTail);
+
+        if (itsReporter && atomic_load_explicit(&itsBytesInUse, memory_order_relaxed) > itsMemoryCap)
+        {
+            streamToReporter();
+        }
+    }
+    return &chunk->entries[index];
+}
+
+static void publishSharedEntry(RawEntry* entry)
+{
+    atomic_store_explicit(&entry->ready, 1, memory_order_release);
+    atomic_fetch_sub(&itsActiveWriters, 1);
+}
+
+// Appends an entry to this thread's capture.  Nobody else writes it, so
+// it needs no atomics.
+static RawEntry* claimCapturedEntry(UnitTestCapture* capture)
+{
+    if (!capture->last || capture->lastCount == CHUNK_ENTRIES)
+    {
+        Chunk* chunk = newChunk();
+
+        if (!chunk)
+        {
+            atomic_fetch_add_explicit(&itsDropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        if (capture->last)
+        {
+            atomic_store_explicit(&capture->last->next, chunk, memory_order_relaxed);
+        }
+        else
+        {
+            capture->first = chunk;
+        }
+        capture->last = chunk;
+        capture->lastCount = 0;
+    }
+    return &capture->last->entries[capture->lastCount++];
+}
+
+static RawEntry* claimEntry(UnitTestResult result, const char* func, int line, uint8_t kind)
+{
+    RawEntry* entry;
+
+    if (result == UNIT_TEST_PASS)
+    {
+        atomic_fetch_add_explicit(&itsPassCount, 1, memory_order_relaxed);
+    }
+    else if (result == UNIT_TEST_FAIL)
+    {
+        atomic_fetch_add_explicit(&itsFailCount, 1, memory_order_relaxed);
+    }
+    else
+    {
+        ;  // Benchmarks count as neither
+    }
+
+    entry = itsCapture ? claimCapturedEntry(itsCapture) : claimSharedEntry();
+    if (entry)
+    {
+        entry->result = (uint8_t)result;
+        entry->kind = kind;
+        entry->line = line;
+        entry->func = func;
+        entry->owned = 0;
+    }
+    return entry;
+}
+
+static void publishEntry(RawEntry* entry)
+{
+    if (itsCapture)
+    {
+        atomic_store_explicit(&entry->ready, 1, memory_order_relaxed);
+    }
+    else
+    {
+        publishSharedEntry(entry);
+    }
+}
+
+static void addMessage(UnitTestResult result, const char* func, int line, const char* msg)
+{
+    RawEntry* entry = claimEntry(result, func, line, KIND_MESSAGE);
+
+    if (entry)
+    {
+        entry->a.str = keepString(msg, &entry->owned, 1);
+        publishEntry(entry);
+    }
+}
+
+static void addNames(UnitTestResult result, const char* func, int line, AssertKind kind, AssertOp op,
+    const char* aName, const char* bName)
+{
+    RawEntry* entry = claimEntry(result, func, line, (uint8_t)kind);
+
+    if (entry)
+    {
+        entry->op = (uint8_t)op;
+        entry->aName = aName;
+        entry->bName = bName;
+        publishEntry(entry);
+    }
+}
+
+static void addSigned(UnitTestResult result, const char* func, int line, AssertKind kind, AssertOp op,
+    const char* aName, const char* bName, int32_t aVal, int32_t bVal)
+{
+    RawEntry* entry = claimEntry(result, func, line, (uint8_t)kind);
+
+    if (entry)
+    {
+        entry->op = (uint8_t)op;
+        entry->aName = aName;
+        entry->bName = bName;
+        entry->a.s = aVal;
+        entry->b.s = bVal;
+        publishEntry(entry);
+    }
+}
+
+static void addUnsigned(UnitTestResult result, const char* func, int line, AssertKind kind, AssertOp op,
+    const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
+{
+    RawEntry* entry = claimEntry(result, func, line, (uint8_t)kind);
+
+    if (entry)
+    {
+        entry->op = (uint8_t)op;
+        entry->aName = aName;
+        entry->bName = bName;
+        entry->a.u = aVal;
+        entry->b.u = bVal;
+        publishEntry(entry);
+    }
+}
+
+static void addFloat(UnitTestResult result, const char* func, int line, AssertKind kind, AssertOp op,
+    const char* aName, const char* bName, double aVal, double bVal)
+{
+    RawEntry* entry = claimEntry(result, func, line, (uint8_t)kind);
+
+    if (entry)
+    {
+        entry->op = (uint8_t)op;
+        entry->aName = aName;
+        entry->bName = bName;
+        entry->a.f = aVal;
+        entry->b.f = bVal;
+        publishEntry(entry);
+    }
+}
+
+static void addStrings(UnitTestResult result, const char* func, int line, AssertOp op,
+    const char* aName, const char* bName, const char* aVal, const char* bVal)
+{
+    RawEntry* entry = claimEntry(result, func, line, KIND_STR);
+
+    if (entry)
+    {
+        entry->op = (uint8_t)op;
+        entry->aName = aName;
+        entry->bName = bName;
+        entry->a.str = keepString(aVal, &entry->owned, 1);
+        entry->b.str = keepString(bVal, &entry->owned, 2);
+        publishEntry(entry);
+    }
+}
+
+// Builds the message of an entry, as the assertion functions used to
+// when they were called.
+static void formatEntry(const RawEntry* entry, char* buf)
+{
+    const char* op = itsOpNames[entry->op];
+
+    switch ((AssertKind)entry->kind)
+    {
+    case KIND_MESSAGE:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s", entry->a.str);
+        break;
+    case KIND_TRUE:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == true", entry->aName);
+        break;
+    case KIND_FALSE:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == false", entry->aName);
+        break;
+    case KIND_S8:
+    case KIND_S16:
+    case KIND_S32:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s %s %s (%d %s %d)", entry->aName, op, entry->bName, (int)entry->a.s, op, (int)entry->b.s);
+        break;
+    case KIND_U8:
+    case KIND_U16:
+    case KIND_U32:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s %s %s (%u %s %u)", entry->aName, op, entry->bName, (unsigned)entry->a.u, op, (unsigned)entry->b.u);
+        break;
+    case KIND_F32:
+    case KIND_F64:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s %s %s (%f %s %f)", entry->aName, op, entry->bName, entry->a.f, op, entry->b.f);
+        break;
+    case KIND_STR:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s %s %s (%s %s %s)", entry->aName, op, entry->bName, entry->a.str, op, entry->b.str);
+        break;
+    case KIND_MEM:
+        snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s %s %s", entry->aName, op, entry->bName);
+        break;
+    default:
+        buf[0] = 0;
+        break;
+    }
+}
+
+// Frees retired chunks if no other producer is between claimEntry() and
+// publishEntry().  A producer calling this counts itself.
+static void freeRetiredChunks(int writersOfOurOwn)
+{
+    if (!itsRetired || atomic_load(&itsActiveWriters) != writersOfOurOwn)
+    {
+        return;
+    }
+    while (itsRetired)
+    {
+        Chunk* chunk = itsRetired;
+
+        itsRetired = chunk->retiredNext;
+        atomic_fetch_sub_explicit(&itsBytesInUse, sizeof(Chunk), memory_order_relaxed);
+        free(chunk);
+    }
+}
+
+// Fills in the result of an entry, message included, but not the
+// overflow flag.
+static void outputEntry(const RawEntry* entry, UnitTestOutput* entryOutput)
+{
+    entryOutput->result = (UnitTestResult)entry->result;
+    entryOutput->overflow = false;
+    entryOutput->line = entry->line;
+    entryOutput->name = entry->func;
+    formatEntry(entry, entryOutput->msg);
+}
 
-            ReleaseMutex(itsMtx);
+static void freeOwnedStrings(const RawEntry* entry)
+{
+    if (entry->owned & 1)
+    {
+        free((void*)entry->a.str);
+    }
+    if (entry->owned & 2)
+    {
+        free((void*)entry->b.str);
+    }
+}
+
+// Takes the next published entry off the log.  Only the holder of
+// itsReading calls this.
+static bool readEntry(UnitTestOutput* entryOutput, int writersOfOurOwn)
+{
+    RawEntry* entry;
+
+    if (itsReadIndex == CHUNK_ENTRIES)
+    {
+        Chunk* next = atomic_load_explicit(&itsHead->next, memory_order_acquire);
+
+        if (!next || atomic_load(&itsTail) == itsHead)
+        {
+            return false;
+        }
+        if (itsHead != &itsFirstChunk)
+        {
+            // A late producer may still follow the chunk's next pointer,
+            // so it is left alone.
+            itsHead->retiredNext = itsRetired;
+            itsRetired = itsHead;
         }
+        itsHead = next;
+        itsReadIndex = 0;
+        freeRetiredChunks(writersOfOurOwn);
+    }
+
+    entry = &itsHead->entries[itsReadIndex];
+    if (!atomic_load_explicit(&entry->ready, memory_order_acquire))
+    {
+        return false;
+    }
+    itsReadIndex++;
+
+    outputEntry(entry, entryOutput);
+    freeOwnedStrings(entry);
+
+    // Entries were dropped for want of memory; flag the last one before
+    // the gap, as the fixed store did when it filled.
+    if (atomic_load_explicit(&itsDropped, memory_order_relaxed) > 0
+        && (itsReadIndex == CHUNK_ENTRIES || !atomic_load_explicit(&itsHead->entries[itsReadIndex].ready, memory_order_acquire))
+        && atomic_exchange_explicit(&itsDropped, 0, memory_order_relaxed) > 0)
+    {
+        entryOutput->overflow = true;
     }
+    return true;
+}
+
+// Called by a producer that found the log over its memory cap: hands
+// every finished entry to the reporter so their chunks can be freed.  If
+// the consumer is reading already, it's left to catch up.
+static void streamToReporter(void)
+{
+    UnitTestOutput output;
+
+    if (atomic_flag_test_and_set_explicit(&itsReading, memory_order_acquire))
+    {
+        return;
+    }
+    while (readEntry(&output, 1))
+    {
+        itsReporter(itsReporterContext, &output);
+    }
+    freeRetiredChunks(1);
+    atomic_flag_clear_explicit(&itsReading, memory_order_release);
 }
 
 void unitTestFail(const char* func, int line, const char* msg)
 {
-    addEntry(UNIT_TEST_FAIL, func, line, msg);
+    addMessage(UNIT_TEST_FAIL, func, line, msg);
 }
 
 void unitTestPass(const char* func, int line, const char* msg)
 {
     if (itsVerbose)
     {
-        addEntry(UNIT_TEST_PASS, func, line, msg);
+        addMessage(UNIT_TEST_PASS, func, line, msg);
     }
 }
 
 bool unitTestGetEntry(UnitTestOutput *entryOutput)
 {
-    bool foundEntry = false;
-    DWORD waitResult = WaitForSingleObject(itsMtx, INFINITE);
+    bool foundEntry;
+
+    while (atomic_flag_test_and_set_explicit(&itsReading, memory_order_acquire))
+    {
+        ;  // A producer is streaming to the reporter
+    }
+    foundEntry = readEntry(entryOutput, 0);
+    atomic_flag_clear_explicit(&itsReading, memory_order_release);
+    return foundEntry;
+}
+
+void unitTestSetMemoryCap(size_t bytes, UnitTestReporter reporter, void* context)
+{
+    itsReporterContext = context;
+    itsMemoryCap = bytes;
+    itsReporter = reporter;
+}
+
+size_t unitTestMemoryInUse(void)
+{
+    return atomic_load_explicit(&itsBytesInUse, memory_order_relaxed);
+}
+
+int32_t unitTestPassCount(void)
+{
+    return atomic_load_explicit(&itsPassCount, memory_order_relaxed);
+}
+
+int32_t unitTestFailCount(void)
+{
+    return atomic_load_explicit(&itsFailCount, memory_order_relaxed);
+}
+
+void unitTestAddOutput(const UnitTestOutput* output)
+{
+    addMessage(output->result, output->name, output->line, output->msg);
+    if (output->overflow)
+    {
+        atomic_fetch_add_explicit(&itsDropped, 1, memory_order_relaxed);
+    }
+}
+
+void unitTestAddCounts(int32_t passes, int32_t failures)
+{
+    atomic_fetch_add_explicit(&itsPassCount, passes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&itsFailCount, failures, memory_order_relaxed);
+}
+
+UnitTestCapture* unitTestCaptureBegin(void)
+{
+    UnitTestCapture* capture = harnessCalloc(1, sizeof(UnitTestCapture));
+
+    // The first chunk is taken now, so a test that records few results
+    // allocates nothing for them while it runs.
+    if (capture)
+    {
+        capture->first = newChunk();
+        capture->last = capture->first;
+        capture->outer = itsCapture;
+    }
+    itsCapture = capture;
+    return capture;
+}
+
+void unitTestCaptureEnd(void)
+{
+    itsCapture = itsCapture ? itsCapture->outer : NULL;
+}
+
+void unitTestCaptureDrain(UnitTestCapture* capture, UnitTestReporter reporter, void* context)
+{
+    Chunk* chunk;
 
-    if (waitResult == WAIT_OBJECT_0)
+    if (!capture)
+    {
+        return;
+    }
+    chunk = capture->first;
+    while (chunk)
     {
-        if (itsEntryHead != itsEntryTail)
+        Chunk* next = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+        unsigned count = (chunk == capture->last) ? capture->lastCount : CHUNK_ENTRIES;
+
+        for (unsigned i = 0; i < count; i++)
         {
-            entryOutput->overflow = itsOutputStore[itsEntryHead].overflow;
-            entryOutput->result = itsOutputStore[itsEntryHead].result;
-            entryOutput->line = itsOutputStore[itsEntryHead].line;
-            strncpy(entryOutput->name, itsOutputStore[itsEntryHead].name, UNIT_TEST_FUNC_NAME_LEN);
-            strncpy(entryOutput->msg, itsOutputStore[itsEntryHead].msg, UNIT_TEST_MESSAGE_LEN);
-            itsEntryHead++;
-            if (itsEntryHead >= ENTRIES_COUNT)
+            const RawEntry* entry = &chunk->entries[i];
+
+            if (reporter)
+            {
+                UnitTestOutput output;
+
+                outputEntry(entry, &output);
+                reporter(context, &output);
+            }
+            freeOwnedStrings(entry);
+            if (entry->result == UNIT_TEST_PASS)
+            {
+                atomic_fetch_sub_explicit(&itsPassCount, 1, memory_order_relaxed);
+            }
+            else if (entry->result == UNIT_TEST_FAIL)
+            {
+                atomic_fetch_sub_explicit(&itsFailCount, 1, memory_order_relaxed);
+            }
+            else
             {
-                itsEntryHead = 0;
+                ;  // Benchmarks were never counted
             }
-            foundEntry = true;
         }
+        // The first chunk is kept for the results to come.
+        if (chunk != capture->first)
+        {
+            atomic_fetch_sub_explicit(&itsBytesInUse, sizeof(Chunk), memory_order_relaxed);
+            free(chunk);
+        }
+        chunk = next;
     }
-    return foundEntry;
+    if (capture->first)
+    {
+        atomic_store_explicit(&capture->first->next, NULL, memory_order_relaxed);
+    }
+    capture->last = capture->first;
+    capture->lastCount = 0;
+}
+
+void unitTestCaptureCommit(UnitTestCapture* capture)
+{
+    Chunk* chunk;
+
+    if (!capture)
+    {
+        return;
+    }
+    chunk = capture->first;
+    while (chunk)
+    {
+        Chunk* next = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+        unsigned count = next ? CHUNK_ENTRIES : capture->lastCount;
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            const RawEntry* from = &chunk->entries[i];
+            RawEntry* to = claimSharedEntry();
+
+            if (!to)
+            {
+                freeOwnedStrings(from);
+                continue;
+            }
+            to->result = from->result;
+            to->kind = from->kind;
+            to->op = from->op;
+            to->owned = from->owned;
+            to->line = from->line;
+            to->func = from->func;
+            to->aName = from->aName;
+            to->bName = from->bName;
+            to->a = from->a;
+            to->b = from->b;
+            publishSharedEntry(to);
+        }
+        atomic_fetch_sub_explicit(&itsBytesInUse, sizeof(Chunk), memory_order_relaxed);
+        free(chunk);
+        chunk = next;
+    }
+    free(capture);
 }
 
 void unitTestAssertTrue(const char* func, int line, const char* exprName, bool exprVal)
 {
     UnitTestResult result = (exprVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == true", exprName);
-    addEntry(result, func, line, buf);
-
+    addNames(result, func, line, KIND_TRUE, OP_EQUAL, exprName, NULL);
 }
 
 void unitTestAssertFalse(const char* func, int line, const char* exprName, bool exprVal)
 {
     UnitTestResult result = (!exprVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == false", exprName);
-    addEntry(result, func, line, buf);
-
+    addNames(result, func, line, KIND_FALSE, OP_EQUAL, exprName, NULL);
 }
 void unitTestAssertTrue(const char* func, int line, const char* exprName, bool exprVal);
 void unitTestAssertFalse(const char* func, int line, const char* exprName, bool exprVal);
@@ -157,97 +805,73 @@ void unitTestAssertFalse(const char* func, int line, const char* exprName, bool
 void unitTestS8Equal(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%hhd == %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS8NotEqual(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%hhd != %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS8LessThan(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%hhd < %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS8GreaterThan(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%hhd > %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS8LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%hhd <= %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS8GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, int8_t aVal, int8_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%hhd >= %hhd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S8, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU8Equal(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%hhu == %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU8NotEqual(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%hhu != %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU8LessThan(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%hhu < %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU8GreaterThan(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%hhu > %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU8LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%hhu <= %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU8GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint8_t aVal, uint8_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%hhu >= %hhu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U8, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 ////////////////
@@ -255,97 +879,73 @@ void unitTestU8GreaterThanOrEqual(const char* func, int line, const char* aName,
 void unitTestS16Equal(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%hd == %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS16NotEqual(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%hd != %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS16LessThan(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%hd < %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS16GreaterThan(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%hd > %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS16LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%hd <= %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS16GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, int16_t aVal, int16_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%hd >= %hd)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S16, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU16Equal(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%hu == %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU16NotEqual(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%hu != %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU16LessThan(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%hu < %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU16GreaterThan(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%hu > %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU16LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%hu <= %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU16GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint16_t aVal, uint16_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%hu >= %hu)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U16, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 ////////////////
@@ -353,97 +953,73 @@ void unitTestU16GreaterThanOrEqual(const char* func, int line, const char* aName
 void unitTestS32Equal(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%d == %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS32NotEqual(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%d != %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS32LessThan(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%d < %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS32GreaterThan(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%d > %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestS32LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%d <= %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestS32GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, int32_t aVal, int32_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%d >= %d)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addSigned(result, func, line, KIND_S32, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU32Equal(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal == bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%u == %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU32NotEqual(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal != bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%u != %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU32LessThan(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%u < %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU32GreaterThan(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%u > %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestU32LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%u <= %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestU32GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, uint32_t aVal, uint32_t bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%u >= %u)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addUnsigned(result, func, line, KIND_U32, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 ////////////////
@@ -455,9 +1031,7 @@ void unitTestF32Equal(const char* func, int line, const char* aName, const char*
     float diff = fabsf(aVal - bVal);
     float largest = (absA > absB) ? absA : absB;
     UnitTestResult result = (diff <= tolerance * largest) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%f == %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF32NotEqual(const char* func, int line, const char* aName, const char* bName, float aVal, float bVal, float tolerance)
@@ -467,41 +1041,31 @@ void unitTestF32NotEqual(const char* func, int line, const char* aName, const ch
     float diff = fabsf(aVal - bVal);
     float largest = (absA > absB) ? absA : absB;
     UnitTestResult result = (diff > tolerance * largest) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%f != %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF32LessThan(const char* func, int line, const char* aName, const char* bName, float aVal, float bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%f < %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestF32GreaterThan(const char* func, int line, const char* aName, const char* bName, float aVal, float bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%f > %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestF32LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, float aVal, float bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%f <= %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF32GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, float aVal, float bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%f >= %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F32, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 ////////////////
@@ -513,9 +1077,7 @@ void unitTestF64Equal(const char* func, int line, const char* aName, const char*
     double diff = fabs(aVal - bVal);
     double largest = (absA > absB) ? absA : absB;
     UnitTestResult result = (diff <= tolerance * largest) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%f == %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF64NotEqual(const char* func, int line, const char* aName, const char* bName, double aVal, double bVal, double tolerance)
@@ -525,41 +1087,31 @@ void unitTestF64NotEqual(const char* func, int line, const char* aName, const ch
     double diff = fabs(aVal - bVal);
     double largest = (absA > absB) ? absA : absB;
     UnitTestResult result = (diff > tolerance * largest) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%f != %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF64LessThan(const char* func, int line, const char* aName, const char* bName, double aVal, double bVal)
 {
     UnitTestResult result = (aVal < bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s < %s (%f < %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_LESS_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestF64GreaterThan(const char* func, int line, const char* aName, const char* bName, double aVal, double bVal)
 {
     UnitTestResult result = (aVal > bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s > %s (%f > %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_GREATER_THAN, aName, bName, aVal, bVal);
 }
 
 void unitTestF64LessThanOrEqual(const char* func, int line, const char* aName, const char* bName, double aVal, double bVal)
 {
     UnitTestResult result = (aVal <= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s <= %s (%f <= %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_LESS_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestF64GreaterThanOrEqual(const char* func, int line, const char* aName, const char* bName, double aVal, double bVal)
 {
     UnitTestResult result = (aVal >= bVal) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s >= %s (%f >= %f)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addFloat(result, func, line, KIND_F64, OP_GREATER_THAN_OR_EQUAL, aName, bName, aVal, bVal);
 }
 
 //////////
@@ -567,17 +1119,13 @@ void unitTestF64GreaterThanOrEqual(const char* func, int line, const char* aName
 void unitTestStrEqual(const char* func, int line, const char* aName, const char* bName, const char* aVal, const char* bVal)
 {
     UnitTestResult result = (strcmp(aVal, bVal) == 0) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s (%s == %s)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addStrings(result, func, line, OP_EQUAL, aName, bName, aVal, bVal);
 }
 
 void unitTestStrNotEqual(const char* func, int line, const char* aName, const char* bName, const char* aVal, const char* bVal)
 {
     UnitTestResult result = (strcmp(aVal, bVal) != 0) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s (%s != %s)", aName, bName, aVal, bVal);
-    addEntry(result, func, line, buf);
+    addStrings(result, func, line, OP_NOT_EQUAL, aName, bName, aVal, bVal);
 }
 
 //////////
@@ -585,15 +1133,11 @@ void unitTestStrNotEqual(const char* func, int line, const char* aName, const ch
 void unitTestMemEqual(const char* func, int line, const char* aName, const char* bName, const void* aVal, const void* bVal, int siz)
 {
     UnitTestResult result = (memcmp(aVal, bVal, siz) == 0) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s == %s", aName, bName);
-    addEntry(result, func, line, buf);
+    addNames(result, func, line, KIND_MEM, OP_EQUAL, aName, bName);
 }
 
 void unitTestMemNotEqual(const char* func, int line, const char* aName, const char* bName, const void* aVal, const void* bVal, int siz)
 {
     UnitTestResult result = (memcmp(aVal, bVal, siz) != 0) ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
-    char buf[UNIT_TEST_MESSAGE_LEN];
-    snprintf(buf, UNIT_TEST_MESSAGE_LEN, "%s != %s", aName, bName);
-    addEntry(result, func, line, buf);
+    addNames(result, func, line, KIND_MEM, OP_NOT_EQUAL, aName, bName);
 }
@@ -16,6 +16,7 @@
 
 // INCLUDE FILES
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // DEFINE AND TYPE DECLARATIONS
@@ -27,6 +28,8 @@ typedef enum UnitTestResult
 {
     UNIT_TEST_PASS = 0,
     UNIT_TEST_FAIL,
+    // A benchmark's figures; neither passes nor fails.
+    UNIT_TEST_BENCH,
     UNIT_TEST_N_RESULT_TYPES
 } UnitTestResult;
 
@@ -34,7 +37,7 @@ typedef struct UnitTestOutput
 {
     UnitTestResult result;
     bool overflow;
-    char name[UNIT_TEST_FUNC_NAME_LEN];
+    const char* name;
     int line;
     char msg[UNIT_TEST_MESSAGE_LEN];
 } UnitTestOutput;
@@ -168,4 +171,46 @@ void unitTestMemNotEqual(const char* func, int lint, const char* aName, const ch
 
 bool unitTestGetEntry(UnitTestOutput* entryOutput);
 
+// Results are kept until read with unitTestGetEntry().  To bound the memory
+// they take, give a cap in bytes and a reporter: once the unread results
+// pass the cap, the assertion that finds it so hands them all to the
+// reporter, on its own thread, and their memory is freed.  The cap is
+// checked as the log grows, a chunk of results at a time.
+typedef void (*UnitTestReporter)(void* context, const UnitTestOutput* entry);
+void unitTestSetMemoryCap(size_t bytes, UnitTestReporter reporter, void* context);
+
+// Bytes held by the result log.
+size_t unitTestMemoryInUse(void);
+
+// Number of passing and failing assertions so far, from any thread.
+int32_t unitTestPassCount(void);
+int32_t unitTestFailCount(void);
+
+// Records a result as read from unitTestGetEntry(), for results passed on
+// from another process.  name is kept as a pointer, as for assertions.
+void unitTestAddOutput(const UnitTestOutput* output);
+// Counts results passed on from another process without their records,
+// for which there was no room, so the pass and fail counts stay whole.
+// Negative counts take back results that were read and thrown away.
+void unitTestAddCounts(int32_t passes, int32_t failures);
+
+// Captures hold a thread's results out of the log, so that tests run at
+// once on several threads can be committed to it in a fixed order.  Begin
+// directs the results recorded on this thread into a new capture, End
+// sends them back to the capture that was current at Begin, or to the log
+// if there was none, and Commit appends the captured results to the log
+// and frees the capture.  Pass and fail counts include captured results
+// from the start.  Begin returns NULL if out of memory, and the results
+// then go straight to the log.
+typedef struct UnitTestCapture UnitTestCapture;
+UnitTestCapture* unitTestCaptureBegin(void);
+void unitTestCaptureEnd(void);
+void unitTestCaptureCommit(UnitTestCapture* capture);
+
+// Hands the results captured so far to reporter, formatted as from
+// unitTestGetEntry(), or drops them if reporter is NULL, and takes them
+// back out of the pass and fail counts.  The capture stays current, so a
+// benchmark that asserts in a loop can keep its memory flat.
+void unitTestCaptureDrain(UnitTestCapture* capture, UnitTestReporter reporter, void* context);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+* @file UnitTestAlloc.c
+* 
+*/
+
+// Counts the allocations made on each thread, for the runner's per-test
+// figures.  On Linux with glibc, malloc(), calloc(), realloc() and free()
+// are defined here, which overrides the C library's for the whole
+// program, and passed on to glibc's own.  Elsewhere nothing is counted.
+// Define UNIT_TEST_NO_ALLOC_HOOK to leave the allocator alone.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "UnitTestRunner.h"
+
+#if defined(__linux__) && defined(__GLIBC__) && !defined(UNIT_TEST_NO_ALLOC_HOOK)
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+// Thread-local, so counting costs no atomics and a test's figures don't
+// include what tests on other threads did.
+static _Thread_local uint64_t itsAllocations;
+static _Thread_local uint64_t itsAllocatedBytes;
+// Nonzero while the harness allocates on this thread.
+static _Thread_local unsigned itsHarnessDepth;
+
+void* malloc(size_t size)
+{
+    if (!itsHarnessDepth)
+    {
+        itsAllocations++;
+        itsAllocatedBytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    if (!itsHarnessDepth)
+    {
+        itsAllocations++;
+        itsAllocatedBytes += count * size;
+    }
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    if (!itsHarnessDepth)
+    {
+        itsAllocations++;
+        itsAllocatedBytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+void unitTestAllocCounts(uint64_t* allocations, uint64_t* bytes)
+{
+    *allocations = itsAllocations;
+    *bytes = itsAllocatedBytes;
+}
+
+void unitTestAllocHarnessBegin(void)
+{
+    itsHarnessDepth++;
+}
+
+void unitTestAllocHarnessEnd(void)
+{
+    itsHarnessDepth--;
+}
+
+#else
+
+void unitTestAllocCounts(uint64_t* allocations, uint64_t* bytes)
+{
+    *allocations = 0;
+    *bytes = 0;
+}
+
+void unitTestAllocHarnessBegin(void)
+{
+}
+
+void unitTestAllocHarnessEnd(void)
+{
+}
+
+#endif
@@ -0,0 +1,451 @@
+/*
+* @file UnitTestBench.c
+* 
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+#include "UnitTestBench.h"
+
+#define BASELINE_LINE_LEN 512
+
+typedef struct Baseline
+{
+    char* name;
+    double nsPerOp;
+} Baseline;
+
+#if defined(_MSC_VER)
+const void* volatile unitTestBenchSink;
+#endif
+
+static const char* itsBaselinePath = "unittest.baselines";
+static bool itsBaselineUpdate;
+
+// This machine's baselines, read on first use.
+static bool itsBaselinesLoaded;
+static Baseline* itsBaselines;
+static int itsBaselineCount;
+static int itsBaselineCapacity;
+
+static char itsSignature[128];
+
+static int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static bool frequencyScaling(void)
+{
+#ifdef __linux__
+    static int scaling = -1;
+
+    if (scaling < 0)
+    {
+        FILE* file;
+        char governor[32] = "";
+
+        // Read from inside the benchmark, so stdio's buffers would be
+        // counted against it.
+        unitTestAllocHarnessBegin();
+        file = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", "r");
+        scaling = 0;
+        if (file)
+        {
+            if (fgets(governor, sizeof(governor), file))
+            {
+                scaling = strncmp(governor, "performance", 11) != 0;
+            }
+            fclose(file);
+        }
+        unitTestAllocHarnessEnd();
+    }
+    return scaling > 0;
+#else
+    return false;
+#endif
+}
+
+static Baseline* findBaseline(const char* name)
+{
+    for (int i = 0; i < itsBaselineCount; i++)
+    {
+        if (strcmp(itsBaselines[i].name, name) == 0)
+        {
+            return &itsBaselines[i];
+        }
+    }
+    return NULL;
+}
+
+static void setBaseline(const char* name, double nsPerOp)
+{
+    Baseline* baseline = findBaseline(name);
+    size_t len = strlen(name);
+
+    if (!baseline)
+    {
+        char* copy;
+
+        if (itsBaselineCount == itsBaselineCapacity)
+        {
+            int capacity = itsBaselineCapacity ? itsBaselineCapacity * 2 : 32;
+            Baseline* grown = realloc(itsBaselines, sizeof(Baseline) * capacity);
+
+            if (!grown)
+            {
+                return;
+            }
+            itsBaselines = grown;
+            itsBaselineCapacity = capacity;
+        }
+        copy = malloc(len + 1);
+        if (!copy)
+        {
+            return;
+        }
+        memcpy(copy, name, len + 1);
+        baseline = &itsBaselines[itsBaselineCount++];
+        baseline->name = copy;
+    }
+    baseline->nsPerOp = nsPerOp;
+}
+
+static void loadBaselines(void)
+{
+    const char* signature = unitTestMachineSignature();
+    size_t signatureLen = strlen(signature);
+    char line[BASELINE_LINE_LEN];
+    FILE* file;
+
+    itsBaselinesLoaded = true;
+    unitTestAllocHarnessBegin();
+    file = fopen(itsBaselinePath, "r");
+    if (!file)
+    {
+        unitTestAllocHarnessEnd();
+        return;
+    }
+    while (fgets(line, sizeof(line), file))
+    {
+        char* name = line + signatureLen + 1;
+        char* value;
+
+        if (strncmp(line, signature, signatureLen) != 0 || line[signatureLen] != '\t')
+        {
+            continue;
+        }
+        value = strchr(name, '\t');
+        if (value)
+        {
+            *value++ = 0;
+            setBaseline(name, strtod(value, NULL));
+        }
+    }
+    fclose(file);
+    unitTestAllocHarnessEnd();
+}
+
+static void describeResult(char* msg, size_t size, const UnitTestBenchResult* result)
+{
+    snprintf(msg, size, "ns/op=%.2f mean=%.2f stddev=%.2f min=%.2f iterations=%llu samples=%d%s",
+        result->median, result->mean, result->stddev, result->min, (unsigned long long)result->iterations,
+        result->samples, result->frequencyScaling ? " cpufreq=scaling" : "");
+}
+
+// Runs func once with the iteration count in bench, and returns the time
+// its loop took.
+static uint64_t runOnce(UnitTestBenchFunc func, UnitTestBench* bench)
+{
+    bench->looped = false;
+    bench->elapsedNanos = 0;
+    func(bench);
+    return bench->elapsedNanos;
+}
+
+uint64_t unitTestBenchNanos(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER count;
+
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&count);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t unitTestBenchStart(UnitTestBench* bench)
+{
+    bench->looped = true;
+    bench->startNanos = unitTestBenchNanos();
+    return bench->iterations;
+}
+
+void unitTestBenchStop(UnitTestBench* bench)
+{
+    bench->elapsedNanos = unitTestBenchNanos() - bench->startNanos;
+}
+
+bool unitTestBenchMeasure(UnitTestBenchFunc func, UnitTestBenchResult* result)
+{
+    UnitTestBench bench = { 0 };
+    double perOp[UNIT_TEST_BENCH_SAMPLES];
+    double sorted[UNIT_TEST_BENCH_SAMPLES];
+    double sum = 0.0;
+    double squares = 0.0;
+    uint64_t warmupStart = unitTestBenchNanos();
+
+    // Grow the count until a run lasts a sample's time.  The runs on the
+    // way, and any more until the warmup time is up, warm the caches, the
+    // branch predictors and the CPU clock.
+    bench.iterations = 1;
+    for (;;)
+    {
+        uint64_t elapsed = runOnce(func, &bench);
+        double grow;
+
+        if (!bench.looped)
+        {
+            return false;
+        }
+        if (elapsed >= UNIT_TEST_BENCH_SAMPLE_NANOS)
+        {
+            if (unitTestBenchNanos() - warmupStart >= UNIT_TEST_BENCH_WARMUP_NANOS)
+            {
+                break;
+            }
+            continue;
+        }
+        grow = elapsed > 0 ? 1.2 * UNIT_TEST_BENCH_SAMPLE_NANOS / (double)elapsed : 10.0;
+        grow = grow < 1.1 ? 1.1 : grow > 10.0 ? 10.0 : grow;
+        bench.iterations = (uint64_t)ceil((double)bench.iterations * grow);
+    }
+
+    for (int s = 0; s < UNIT_TEST_BENCH_SAMPLES; s++)
+    {
+        perOp[s] = (double)runOnce(func, &bench) / (double)bench.iterations;
+        sorted[s] = perOp[s];
+        sum += perOp[s];
+    }
+    qsort(sorted, UNIT_TEST_BENCH_SAMPLES, sizeof(double), compareDoubles);
+
+    result->iterations = bench.iterations;
+    result->samples = UNIT_TEST_BENCH_SAMPLES;
+    result->mean = sum / UNIT_TEST_BENCH_SAMPLES;
+    for (int s = 0; s < UNIT_TEST_BENCH_SAMPLES; s++)
+    {
+        squares += (perOp[s] - result->mean) * (perOp[s] - result->mean);
+    }
+    result->stddev = sqrt(squares / (UNIT_TEST_BENCH_SAMPLES - 1));
+    result->median = (sorted[(UNIT_TEST_BENCH_SAMPLES - 1) / 2] + sorted[UNIT_TEST_BENCH_SAMPLES / 2]) / 2.0;
+    result->min = sorted[0];
+    result->frequencyScaling = frequencyScaling();
+    return true;
+}
+
+void unitTestBenchmark(const char* name, int line, UnitTestBenchFunc func)
+{
+    UnitTestBenchResult result;
+    UnitTestOutput output = { UNIT_TEST_BENCH, false, name, line, "" };
+
+    if (!unitTestBenchMeasure(func, &result))
+    {
+        output.result = UNIT_TEST_FAIL;
+        snprintf(output.msg, sizeof(output.msg), "%s never reached BENCHMARK_LOOP()", name);
+    }
+    else
+    {
+        describeResult(output.msg, sizeof(output.msg), &result);
+    }
+    unitTestAddOutput(&output);
+}
+
+void unitTestBenchmarkBaseline(const char* name, int line, UnitTestBenchFunc func, double tolerance)
+{
+    UnitTestBenchResult result;
+    UnitTestBenchResult best = { 0 };
+    UnitTestOutput output = { UNIT_TEST_BENCH, false, name, line, "" };
+    double baseline = 0.0;
+    bool haveBaseline = !itsBaselineUpdate && unitTestBaselineGet(name, &baseline);
+    double limit = baseline * (1.0 + tolerance);
+    int attempts = 0;
+
+    while (attempts < UNIT_TEST_BENCH_ATTEMPTS)
+    {
+        if (!unitTestBenchMeasure(func, &result))
+        {
+            output.result = UNIT_TEST_FAIL;
+            snprintf(output.msg, sizeof(output.msg), "%s never reached BENCHMARK_LOOP()", name);
+            unitTestAddOutput(&output);
+            return;
+        }
+        if (attempts++ == 0 || result.median < best.median)
+        {
+            best = result;
+        }
+        if (!haveBaseline || best.median <= limit)
+        {
+            break;
+        }
+    }
+    describeResult(output.msg, sizeof(output.msg), &best);
+    unitTestAddOutput(&output);
+
+    if (itsBaselineUpdate)
+    {
+        if (unitTestBaselinePut(name, best.median))
+        {
+            output.result = UNIT_TEST_PASS;
+            snprintf(output.msg, sizeof(output.msg), "baseline set to %.2f ns/op", best.median);
+        }
+        else
+        {
+            output.result = UNIT_TEST_FAIL;
+            snprintf(output.msg, sizeof(output.msg), "couldn't write baseline to %s", itsBaselinePath);
+        }
+    }
+    else if (!haveBaseline)
+    {
+        output.result = UNIT_TEST_PASS;
+        snprintf(output.msg, sizeof(output.msg), "no baseline for %s", unitTestMachineSignature());
+    }
+    else
+    {
+        output.result = best.median <= limit ? UNIT_TEST_PASS : UNIT_TEST_FAIL;
+        snprintf(output.msg, sizeof(output.msg), "ns/op=%.2f baseline=%.2f limit=%.2f change=%+.1f%% attempts=%d",
+            best.median, baseline, limit, (best.median / baseline - 1.0) * 100.0, attempts);
+    }
+    unitTestAddOutput(&output);
+}
+
+void unitTestBaselineSetFile(const char* path, bool update)
+{
+    itsBaselinePath = path;
+    itsBaselineUpdate = update;
+    itsBaselinesLoaded = false;
+    for (int i = 0; i < itsBaselineCount; i++)
+    {
+        free(itsBaselines[i].name);
+    }
+    itsBaselineCount = 0;
+}
+
+bool unitTestBaselineGet(const char* name, double* nsPerOp)
+{
+    Baseline* baseline;
+
+    if (!itsBaselinesLoaded)
+    {
+        loadBaselines();
+    }
+    baseline = findBaseline(name);
+    if (baseline)
+    {
+        *nsPerOp = baseline->nsPerOp;
+    }
+    return baseline != NULL;
+}
+
+bool unitTestBaselinePut(const char* name, double nsPerOp)
+{
+    // Appended with one write, so children of an isolated run, each with
+    // a table of their own, don't lose each other's lines.
+    FILE* file;
+    bool written;
+
+    unitTestAllocHarnessBegin();
+    file = fopen(itsBaselinePath, "a");
+    if (!file)
+    {
+        unitTestAllocHarnessEnd();
+        return false;
+    }
+    written = fprintf(file, "%s\t%s\t%.3f\n", unitTestMachineSignature(), name, nsPerOp) > 0;
+    written = fclose(file) == 0 && written;
+    if (!itsBaselinesLoaded)
+    {
+        loadBaselines();
+    }
+    setBaseline(name, nsPerOp);
+    unitTestAllocHarnessEnd();
+    return written;
+}
+
+const char* unitTestMachineSignature(void)
+{
+    char model[96] = "unknown";
+    int cores = 1;
+
+    if (itsSignature[0])
+    {
+        return itsSignature;
+    }
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    const char* identifier = getenv("PROCESSOR_IDENTIFIER");
+
+    GetSystemInfo(&info);
+    cores = (int)info.dwNumberOfProcessors;
+    if (identifier)
+    {
+        snprintf(model, sizeof(model), "%s", identifier);
+    }
+#else
+    FILE* file;
+    char line[BASELINE_LINE_LEN];
+
+    unitTestAllocHarnessBegin();
+    file = fopen("/proc/cpuinfo", "r");
+    cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (file)
+    {
+        while (fgets(line, sizeof(line), file))
+        {
+            char* colon = strchr(line, ':');
+
+            if (strncmp(line, "model name", 10) == 0 && colon)
+            {
+                snprintf(model, sizeof(model), "%s", colon + 2);
+                break;
+            }
+        }
+        fclose(file);
+    }
+    unitTestAllocHarnessEnd();
+#endif
+    model[strcspn(model, "\r\n")] = 0;
+    snprintf(itsSignature, sizeof(itsSignature), "%s/%d", model, cores);
+    for (char* c = itsSignature; *c; c++)
+    {
+        if (*c == ' ' || *c == '\t')
+        {
+            *c = '_';
+        }
+    }
+    return itsSignature;
+}
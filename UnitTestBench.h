@@ -0,0 +1,180 @@
+#ifndef UNITTESTBENCH_H
+#define UNITTESTBENCH_H
+
+/************************************************
+* (c) Copyright TBD
+* 
+* Name: UnitTestBench.h
+* 
+* Description: Micro-benchmarks run alongside the unit tests
+* 
+* Revision History:
+* 
+* Target:
+* 
+*/
+
+// INCLUDE FILES
+#include <stdbool.h>
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "UnitTestRunner.h"
+
+// DEFINE AND TYPE DECLARATIONS
+
+// Each benchmark is run with a growing iteration count until one run
+// lasts a sample's time and the warmup time has passed, then timed for
+// this many samples of that count.
+#define UNIT_TEST_BENCH_SAMPLES 20
+#define UNIT_TEST_BENCH_SAMPLE_NANOS 10000000
+#define UNIT_TEST_BENCH_WARMUP_NANOS 50000000
+
+// Measurements a baseline check takes before it fails.
+#define UNIT_TEST_BENCH_ATTEMPTS 3
+
+typedef struct UnitTestBench
+{
+    uint64_t iterations;
+    uint64_t startNanos;
+    uint64_t elapsedNanos;
+    bool looped;
+} UnitTestBench;
+
+typedef void (*UnitTestBenchFunc)(UnitTestBench* bench);
+
+// Nanoseconds per iteration over the samples.
+typedef struct UnitTestBenchResult
+{
+    uint64_t iterations;
+    int samples;
+    double mean;
+    double median;
+    double stddev;
+    double min;
+    // The CPU clock may change under the benchmark: on Linux, the cpufreq
+    // governor isn't "performance".
+    bool frequencyScaling;
+} UnitTestBenchResult;
+
+// BENCHMARK(name) { ... } defines a benchmark and registers it as a
+// serial test, so it runs with nothing else running.  Only the body of
+// BENCHMARK_LOOP(bench) is timed; set-up before it and tear-down after it
+// are not.  For example,
+//
+// BENCHMARK(benchSnprintf)
+// {
+//     char buf[16];
+//
+//     BENCHMARK_LOOP(bench)
+//     {
+//         snprintf(buf, sizeof(buf), "%d", 42);
+//         DO_NOT_OPTIMIZE(buf);
+//     }
+// }
+//
+// The result is recorded as a UNIT_TEST_BENCH entry whose message reads
+// "ns/op=... mean=... stddev=... min=... iterations=... samples=...",
+// with ns/op the median over the samples; " cpufreq=scaling" is added if
+// the CPU clock may have changed during it.  Times are wall-clock, so
+// they move with the CPU's clock: turbo, power saving and thermal limits
+// all show up in them, and figures from different machines, or different
+// governors, don't compare.
+#define BENCHMARK(name) \
+    static void name(UnitTestBench* bench); \
+    static void unitTestBenchCase_##name(void) { unitTestBenchmark(#name, __LINE__, name); } \
+    UNIT_TEST_REGISTER(name, unitTestBenchCase_##name, true) \
+    static void name(UnitTestBench* bench)
+
+// BENCHMARK_BASELINE(name, tolerance) { ... } is a benchmark that also
+// fails if its ns/op is over its baseline * (1 + tolerance).  Baselines
+// are kept in a file, by name and machine signature (see
+// unitTestBaselineSetFile()); with none for this machine it only records
+// its figures.  ns/op is the median over the samples, so outliers within
+// a measurement don't count; a measurement over the limit is retaken, up
+// to UNIT_TEST_BENCH_ATTEMPTS in all, and the best median is the one
+// compared, so a burst of load on the machine doesn't fail it either.
+#define BENCHMARK_BASELINE(name, tolerance) \
+    static void name(UnitTestBench* bench); \
+    static void unitTestBenchCase_##name(void) { unitTestBenchmarkBaseline(#name, __LINE__, name, tolerance); } \
+    UNIT_TEST_REGISTER(name, unitTestBenchCase_##name, true) \
+    static void name(UnitTestBench* bench)
+
+#define BENCHMARK_LOOP(bench) \
+    for (uint64_t unitTestLeft = unitTestBenchStart(bench); \
+        unitTestLeft > 0 || (unitTestBenchStop(bench), false); unitTestLeft--)
+
+// Makes the compiler assume x is read, and so keep the code that computes
+// it, without costing an instruction.
+#define DO_NOT_OPTIMIZE(x) unitTestDoNotOptimize(&(x))
+
+// Makes the compiler assume all memory is read and written, so pending
+// stores are done.
+#define CLOBBER_MEMORY() unitTestClobberMemory()
+
+#if defined(_MSC_VER)
+extern const void* volatile unitTestBenchSink;
+
+static inline void unitTestDoNotOptimize(const void* p)
+{
+    unitTestBenchSink = p;
+    _ReadWriteBarrier();
+}
+
+static inline void unitTestClobberMemory(void)
+{
+    _ReadWriteBarrier();
+}
+#else
+static inline void unitTestDoNotOptimize(const void* p)
+{
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+static inline void unitTestClobberMemory(void)
+{
+    __asm__ volatile("" : : : "memory");
+}
+#endif
+
+// PUBLIC FUNCTION PROTOTYPES
+
+// Monotonic clock, in nanoseconds.
+uint64_t unitTestBenchNanos(void);
+
+// Used by BENCHMARK_LOOP().
+uint64_t unitTestBenchStart(UnitTestBench* bench);
+void unitTestBenchStop(UnitTestBench* bench);
+
+// Measures func.  Returns false if it never reached BENCHMARK_LOOP().
+bool unitTestBenchMeasure(UnitTestBenchFunc func, UnitTestBenchResult* result);
+
+// Measures func and records the result under name.  BENCHMARK() calls this.
+void unitTestBenchmark(const char* name, int line, UnitTestBenchFunc func);
+
+// As unitTestBenchmark(), and checks the result against the baseline.
+// BENCHMARK_BASELINE() calls this.
+void unitTestBenchmarkBaseline(const char* name, int line, UnitTestBenchFunc func, double tolerance);
+
+// Baselines are read from path, "unittest.baselines" by default, a line
+// per benchmark and machine:
+//     <machine signature> <tab> <name> <tab> <ns/op>
+// With update true, the figures measured are appended instead of checked,
+// and become the baselines for later runs: of several lines for the same
+// benchmark and machine, the last counts.  Lines for other machines are
+// kept but not used.
+void unitTestBaselineSetFile(const char* path, bool update);
+
+// The baseline for name on this machine.  Returns false if there is none.
+bool unitTestBaselineGet(const char* name, double* nsPerOp);
+
+// Appends a baseline for name on this machine.  Returns false if the file
+// couldn't be written.
+bool unitTestBaselinePut(const char* name, double nsPerOp);
+
+// Identifies the machine, for baselines: the CPU model and core count,
+// with no white space.
+const char* unitTestMachineSignature(void);
+
+#endif
@@ -0,0 +1,382 @@
+/*
+* @file UnitTestReport.c
+* 
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "UnitTestReport.h"
+
+// A test's output is written out at its end if it has waited this long,
+// so a slow suite still shows progress.
+#define WRITER_FLUSH_NANOS 100000000
+
+static UnitTestReport* itsReports[UNIT_TEST_MAX_REPORTS];
+static int itsReportCount;
+
+static const char* const itsResultNames[] = { "pass", "fail", "bench" };
+
+static uint64_t nowNanos(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void unitTestWriterInit(UnitTestWriter* writer, FILE* file)
+{
+    writer->file = file;
+    writer->flushNanos = WRITER_FLUSH_NANOS;
+    writer->lastFlush = nowNanos();
+    writer->len = 0;
+}
+
+void unitTestWriterFlush(UnitTestWriter* writer)
+{
+    if (writer->len > 0)
+    {
+        fwrite(writer->buf, 1, writer->len, writer->file);
+        writer->len = 0;
+    }
+    fflush(writer->file);
+    writer->lastFlush = nowNanos();
+}
+
+void unitTestWrite(UnitTestWriter* writer, const char* data, size_t len)
+{
+    if (writer->len + len > sizeof(writer->buf))
+    {
+        fwrite(writer->buf, 1, writer->len, writer->file);
+        writer->len = 0;
+        if (len > sizeof(writer->buf))
+        {
+            fwrite(data, 1, len, writer->file);
+            return;
+        }
+    }
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void writeString(UnitTestWriter* writer, const char* text)
+{
+    unitTestWrite(writer, text, strlen(text));
+}
+
+void unitTestWritef(UnitTestWriter* writer, const char* format, ...)
+{
+    char line[512];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0)
+    {
+        unitTestWrite(writer, line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+    }
+}
+
+void unitTestWriteXml(UnitTestWriter* writer, const char* text)
+{
+    const char* run = text;
+
+    for (; *text; text++)
+    {
+        const char* escape;
+
+        switch (*text)
+        {
+        case '<': escape = "&lt;"; break;
+        case '>': escape = "&gt;"; break;
+        case '&': escape = "&amp;"; break;
+        case '"': escape = "&quot;"; break;
+        case '\'': escape = "&apos;"; break;
+        // Kept as references, which attribute values don't normalise to
+        // spaces.
+        case '\t': escape = "&#9;"; break;
+        case '\n': escape = "&#10;"; break;
+        case '\r': escape = "&#13;"; break;
+        default:
+            // XML 1.0 has no way to write the other control characters,
+            // even as references.
+            if ((unsigned char)*text >= 0x20)
+            {
+                continue;
+            }
+            escape = "?";
+            break;
+        }
+        unitTestWrite(writer, run, (size_t)(text - run));
+        writeString(writer, escape);
+        run = text + 1;
+    }
+    unitTestWrite(writer, run, (size_t)(text - run));
+}
+
+void unitTestWriteJson(UnitTestWriter* writer, const char* text)
+{
+    const char* run = text;
+
+    for (; *text; text++)
+    {
+        unsigned char c = (unsigned char)*text;
+
+        if (c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+        unitTestWrite(writer, run, (size_t)(text - run));
+        if (c == '"' || c == '\\')
+        {
+            char escape[2] = { '\\', (char)c };
+
+            unitTestWrite(writer, escape, 2);
+        }
+        else
+        {
+            unitTestWritef(writer, "\\u%04x", c);
+        }
+        run = text + 1;
+    }
+    unitTestWrite(writer, run, (size_t)(text - run));
+}
+
+static void textResult(UnitTestReport* report, const UnitTestCase* test, const UnitTestOutput* output)
+{
+    static const char* const tags[] = { "[PASS]", "[FAIL]", "[BENCH]" };
+
+    (void)test;
+    unitTestWritef(report->writer, "%s %s:%d %s\n", tags[output->result], output->name, output->line, output->msg);
+}
+
+void unitTestReportText(UnitTestReport* report, UnitTestWriter* writer)
+{
+    memset(report, 0, sizeof(*report));
+    report->result = textResult;
+    report->writer = writer;
+}
+
+static void tapBegin(UnitTestReport* report, int tests)
+{
+    unitTestWritef(report->writer, "TAP version 13\n1..%d\n", tests);
+}
+
+static void tapResult(UnitTestReport* report, const UnitTestCase* test, const UnitTestOutput* output)
+{
+    (void)test;
+    if (output->result != UNIT_TEST_PASS)
+    {
+        unitTestWritef(report->writer, "# %s %s:%d %s\n", itsResultNames[output->result], output->name,
+            output->line, output->msg);
+    }
+}
+
+static void tapTestEnd(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics,
+    int failures)
+{
+    (void)metrics;
+    unitTestWritef(report->writer, "%s %d - %s\n", failures ? "not ok" : "ok", report->tests, test->name);
+}
+
+void unitTestReportTap(UnitTestReport* report, UnitTestWriter* writer)
+{
+    memset(report, 0, sizeof(*report));
+    report->begin = tapBegin;
+    report->result = tapResult;
+    report->testEnd = tapTestEnd;
+    report->writer = writer;
+}
+
+static void junitBegin(UnitTestReport* report, int tests)
+{
+    (void)tests;
+    unitTestWritef(report->writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuite name=\"UnitTest\">\n");
+}
+
+static void junitTestBegin(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics)
+{
+    writeString(report->writer, "  <testcase classname=\"UnitTest\" name=\"");
+    unitTestWriteXml(report->writer, test->name);
+    unitTestWritef(report->writer, "\" time=\"%.6f\">\n", metrics->wallSeconds);
+}
+
+static void junitResult(UnitTestReport* report, const UnitTestCase* test, const UnitTestOutput* output)
+{
+    (void)test;
+    if (output->result == UNIT_TEST_FAIL)
+    {
+        writeString(report->writer, "    <failure message=\"");
+        unitTestWriteXml(report->writer, output->msg);
+        writeString(report->writer, "\">");
+        unitTestWriteXml(report->writer, output->name);
+        unitTestWritef(report->writer, ":%d</failure>\n", output->line);
+    }
+    else if (output->result == UNIT_TEST_BENCH)
+    {
+        writeString(report->writer, "    <system-out>");
+        unitTestWriteXml(report->writer, output->msg);
+        writeString(report->writer, "</system-out>\n");
+    }
+}
+
+static void junitTestEnd(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics,
+    int failures)
+{
+    (void)test;
+    (void)metrics;
+    (void)failures;
+    writeString(report->writer, "  </testcase>\n");
+}
+
+static void junitEnd(UnitTestReport* report, const UnitTestRunStats* stats)
+{
+    (void)stats;
+    writeString(report->writer, "</testsuite>\n");
+}
+
+void unitTestReportJUnit(UnitTestReport* report, UnitTestWriter* writer)
+{
+    memset(report, 0, sizeof(*report));
+    report->begin = junitBegin;
+    report->testBegin = junitTestBegin;
+    report->result = junitResult;
+    report->testEnd = junitTestEnd;
+    report->end = junitEnd;
+    report->writer = writer;
+}
+
+static void jsonResult(UnitTestReport* report, const UnitTestCase* test, const UnitTestOutput* output)
+{
+    writeString(report->writer, "{\"type\":\"result\",\"test\":\"");
+    unitTestWriteJson(report->writer, test->name);
+    unitTestWritef(report->writer, "\",\"result\":\"%s\",\"func\":\"", itsResultNames[output->result]);
+    unitTestWriteJson(report->writer, output->name);
+    unitTestWritef(report->writer, "\",\"line\":%d,\"message\":\"", output->line);
+    unitTestWriteJson(report->writer, output->msg);
+    writeString(report->writer, output->overflow ? "\",\"overflow\":true}\n" : "\"}\n");
+}
+
+static void jsonTestEnd(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics,
+    int failures)
+{
+    writeString(report->writer, "{\"type\":\"test\",\"test\":\"");
+    unitTestWriteJson(report->writer, test->name);
+    unitTestWritef(report->writer, "\",\"failures\":%d,\"wall\":%.6f,\"cpu\":%.6f,\"allocations\":%llu,"
+        "\"allocated_bytes\":%llu,\"peak_rss_delta_kb\":%ld}\n", failures, metrics->wallSeconds,
+        metrics->cpuSeconds, (unsigned long long)metrics->allocations,
+        (unsigned long long)metrics->allocatedBytes, metrics->peakRssDeltaKb);
+}
+
+static void jsonEnd(UnitTestReport* report, const UnitTestRunStats* stats)
+{
+    unitTestWritef(report->writer, "{\"type\":\"run\",\"tests\":%d,\"workers\":%d,\"wall\":%.6f,\"serial\":%.6f,"
+        "\"crashed\":%d,\"timed_out\":%d,\"passed\":%d,\"failed\":%d}\n", stats->tests, stats->workers,
+        stats->wallSeconds, stats->serialSeconds, stats->crashed, stats->timedOut,
+        (int)unitTestPassCount(), (int)unitTestFailCount());
+}
+
+void unitTestReportJsonLines(UnitTestReport* report, UnitTestWriter* writer)
+{
+    memset(report, 0, sizeof(*report));
+    report->result = jsonResult;
+    report->testEnd = jsonTestEnd;
+    report->end = jsonEnd;
+    report->writer = writer;
+}
+
+bool unitTestAddReport(UnitTestReport* report)
+{
+    if (itsReportCount == UNIT_TEST_MAX_REPORTS)
+    {
+        return false;
+    }
+    itsReports[itsReportCount++] = report;
+    return true;
+}
+
+bool unitTestReporting(void)
+{
+    return itsReportCount > 0;
+}
+
+void unitTestReportBegin(int tests)
+{
+    for (int r = 0; r < itsReportCount; r++)
+    {
+        UnitTestReport* report = itsReports[r];
+
+        report->tests = 0;
+        if (report->begin)
+        {
+            report->begin(report, tests);
+        }
+    }
+}
+
+void unitTestReportTest(const UnitTestCase* test, const UnitTestMetrics* metrics)
+{
+    UnitTestOutput output;
+    int failures = 0;
+
+    for (int r = 0; r < itsReportCount; r++)
+    {
+        UnitTestReport* report = itsReports[r];
+
+        report->tests++;
+        if (report->testBegin)
+        {
+            report->testBegin(report, test, metrics);
+        }
+    }
+    while (unitTestGetEntry(&output))
+    {
+        failures += output.result == UNIT_TEST_FAIL;
+        for (int r = 0; r < itsReportCount; r++)
+        {
+            if (itsReports[r]->result)
+            {
+                itsReports[r]->result(itsReports[r], test, &output);
+            }
+        }
+    }
+    for (int r = 0; r < itsReportCount; r++)
+    {
+        UnitTestReport* report = itsReports[r];
+
+        if (report->testEnd)
+        {
+            report->testEnd(report, test, metrics, failures);
+        }
+        if (report->writer && nowNanos() - report->writer->lastFlush >= report->writer->flushNanos)
+        {
+            unitTestWriterFlush(report->writer);
+        }
+    }
+}
+
+void unitTestReportEnd(const UnitTestRunStats* stats)
+{
+    for (int r = 0; r < itsReportCount; r++)
+    {
+        UnitTestReport* report = itsReports[r];
+
+        if (report->end)
+        {
+            report->end(report, stats);
+        }
+        if (report->writer)
+        {
+            unitTestWriterFlush(report->writer);
+        }
+    }
+}
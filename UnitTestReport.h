@@ -0,0 +1,100 @@
+#ifndef UNITTESTREPORT_H
+#define UNITTESTREPORT_H
+
+/************************************************
+* (c) Copyright TBD
+* 
+* Name: UnitTestReport.h
+* 
+* Description: Streams test results as text, TAP, JUnit XML or JSON lines
+* 
+* Revision History:
+* 
+* Target:
+* 
+*/
+
+// INCLUDE FILES
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "UnitTest.h"
+#include "UnitTestRunner.h"
+
+// DEFINE AND TYPE DECLARATIONS
+
+#define UNIT_TEST_WRITER_SIZE 65536
+#define UNIT_TEST_MAX_REPORTS 8
+
+// Output buffered in memory and written to the file when full, at the end
+// of a test if the last write was more than flushNanos ago, and at the
+// end of the run; never a line at a time.
+typedef struct UnitTestWriter
+{
+    FILE* file;
+    uint64_t flushNanos;
+    uint64_t lastFlush;
+    size_t len;
+    char buf[UNIT_TEST_WRITER_SIZE];
+} UnitTestWriter;
+
+// A report is told of the run as the runners commit each test, in the
+// order of tests[]: testBegin(), result() for each of its results, then
+// testEnd() with the number of them that failed.  A test is committed
+// once it and every test before it have run, so results stream out while
+// later tests run, and what is held at any time is the results of the
+// tests finished out of turn.  Custom reports fill in the functions they
+// need; any may be NULL.
+typedef struct UnitTestReport UnitTestReport;
+struct UnitTestReport
+{
+    void (*begin)(UnitTestReport* report, int tests);
+    void (*testBegin)(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics);
+    void (*result)(UnitTestReport* report, const UnitTestCase* test, const UnitTestOutput* output);
+    void (*testEnd)(UnitTestReport* report, const UnitTestCase* test, const UnitTestMetrics* metrics,
+        int failures);
+    void (*end)(UnitTestReport* report, const UnitTestRunStats* stats);
+    UnitTestWriter* writer;
+    // Tests reported so far.
+    int tests;
+};
+
+// PUBLIC FUNCTION PROTOTYPES
+
+void unitTestWriterInit(UnitTestWriter* writer, FILE* file);
+void unitTestWrite(UnitTestWriter* writer, const char* data, size_t len);
+void unitTestWritef(UnitTestWriter* writer, const char* format, ...);
+// Writes text escaped for an XML attribute or text, or a JSON string.
+// Control characters XML can't hold, all but tab, LF and CR, are written
+// to XML as '?'.
+void unitTestWriteXml(UnitTestWriter* writer, const char* text);
+void unitTestWriteJson(UnitTestWriter* writer, const char* text);
+void unitTestWriterFlush(UnitTestWriter* writer);
+
+// Set up a report of each format, writing to writer:
+// - Text: "[PASS] func:line message" for each result, as main.c printed
+// - TAP version 13: a plan, then "ok" or "not ok" for each test, after
+//   its failures as comments
+// - JUnit XML: a testsuite with a testcase for each test, and a failure
+//   element for each failed result.  The testsuite's counts aren't known
+//   until the end, so it has none; CI tools count the testcases.
+// - JSON lines: an object for each result, each test, and the run
+void unitTestReportText(UnitTestReport* report, UnitTestWriter* writer);
+void unitTestReportTap(UnitTestReport* report, UnitTestWriter* writer);
+void unitTestReportJUnit(UnitTestReport* report, UnitTestWriter* writer);
+void unitTestReportJsonLines(UnitTestReport* report, UnitTestWriter* writer);
+
+// Adds a report for the runners to stream to.  Returns false if there are
+// UNIT_TEST_MAX_REPORTS already.  Once a report is added, the runners read
+// results off the log with unitTestGetEntry() as they commit each test;
+// results recorded outside any test are reported with the next.
+bool unitTestAddReport(UnitTestReport* report);
+
+// Called by the runners.
+bool unitTestReporting(void);
+void unitTestReportBegin(int tests);
+void unitTestReportTest(const UnitTestCase* test, const UnitTestMetrics* metrics);
+void unitTestReportEnd(const UnitTestRunStats* stats);
+
+#endif
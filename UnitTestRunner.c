@@ -0,0 +1,1185 @@
+/*
+* @file UnitTestRunner.c
+* 
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _DEFAULT_SOURCE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+#include "UnitTestReport.h"
+#include "UnitTestRunner.h"
+
+#define RUNNER_MAX_WORKERS 64
+
+// Finished tests that may wait to be committed before workers turn to
+// committing them and to the earliest tests, and twice that before they
+// stop taking new tests, so a report or a test slower than the rest
+// doesn't leave ever more results held.
+#define RUNNER_MAX_PENDING 64
+
+// Results one test can pass back from an isolated child, the last
+// ISOLATED_FAILURE_RESERVE of them kept for failures.  Results past that
+// are only counted, and the last one kept is flagged as having overflowed.
+#define ISOLATED_MAX_RESULTS 1024
+#define ISOLATED_FAILURE_RESERVE 64
+
+// Each worker has a deque of test indices, a slice of the run's order.  The
+// set of tests is fixed before the run, so nothing is ever pushed: the
+// owner pops from the bottom and thieves take from the top, both with a
+// compare-and-swap on one word holding the two ends.
+typedef struct Deque
+{
+    // Top in the high half, bottom in the low.
+    _Atomic uint64_t ends;
+    const int* indices;
+} Deque;
+
+// Commits the captures of finished tests to the log in the order of
+// tests[], each once it and every test before it are done, and reports
+// them.
+typedef struct Commits
+{
+    const UnitTestCase* tests;
+    UnitTestCapture** captures;
+    const UnitTestMetrics* metrics;
+    atomic_bool* finished;
+    int count;
+    int next;
+    // Finished and not yet committed.
+    atomic_int pending;
+    // Set once the commits reach a serial test while the workers run.  It
+    // runs after they are done, so nothing behind it can be committed until
+    // then and the limit on pending results doesn't apply.
+    atomic_bool blocked;
+    // False for a run nested in a test of another, which leaves the
+    // reports to that one.
+    bool reporting;
+} Commits;
+
+typedef struct Runner
+{
+    const UnitTestCase* tests;
+    UnitTestCapture** captures;
+    UnitTestMetrics* metrics;
+    int workers;
+    Deque deques[RUNNER_MAX_WORKERS];
+    // Held by the worker committing.  A worker that finds it taken leaves
+    // its test to the holder.
+    mtx_t commitLock;
+    Commits commits;
+} Runner;
+
+typedef struct Worker
+{
+    Runner* runner;
+    int index;
+} Worker;
+
+// Where the metrics of a test are taken from.
+typedef struct MetricsMark
+{
+    double wall;
+    double cpu;
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    long peakRssKb;
+} MetricsMark;
+
+static UnitTestCase* itsRegistered;
+static int itsRegisteredCount;
+// unitTestRun() calls under way, counting any nested in a test.
+static atomic_int itsRunDepth;
+static int itsRegisteredCapacity;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static double threadCpuSeconds(void)
+{
+#ifdef _WIN32
+    FILETIME created;
+    FILETIME exited;
+    FILETIME kernel;
+    FILETIME user;
+
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user))
+    {
+        return 0.0;
+    }
+    // 100 ns units
+    return ((double)(((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime)
+        + (double)(((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) * 1e-7;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static long peakRssKb(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void markMetrics(MetricsMark* mark)
+{
+    mark->wall = now();
+    mark->cpu = threadCpuSeconds();
+    unitTestAllocCounts(&mark->allocations, &mark->allocatedBytes);
+    mark->peakRssKb = peakRssKb();
+}
+
+static void takeMetrics(const MetricsMark* mark, UnitTestMetrics* metrics)
+{
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+
+    metrics->wallSeconds = now() - mark->wall;
+    metrics->cpuSeconds = threadCpuSeconds() - mark->cpu;
+    unitTestAllocCounts(&allocations, &allocatedBytes);
+    metrics->allocations = allocations - mark->allocations;
+    metrics->allocatedBytes = allocatedBytes - mark->allocatedBytes;
+    metrics->peakRssDeltaKb = peakRssKb() - mark->peakRssKb;
+}
+
+static int coreCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+static uint64_t packEnds(uint32_t top, uint32_t bottom)
+{
+    return ((uint64_t)top << 32) | bottom;
+}
+
+static bool popBottom(Deque* deque, int* test)
+{
+    uint64_t ends = atomic_load_explicit(&deque->ends, memory_order_relaxed);
+
+    for (;;)
+    {
+        uint32_t top = (uint32_t)(ends >> 32);
+        uint32_t bottom = (uint32_t)ends;
+
+        if (top >= bottom)
+        {
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&deque->ends, &ends, packEnds(top, bottom - 1),
+            memory_order_relaxed, memory_order_relaxed))
+        {
+            *test = deque->indices[bottom - 1];
+            return true;
+        }
+    }
+}
+
+static bool stealTop(Deque* deque, int* test)
+{
+    uint64_t ends = atomic_load_explicit(&deque->ends, memory_order_relaxed);
+
+    for (;;)
+    {
+        uint32_t top = (uint32_t)(ends >> 32);
+        uint32_t bottom = (uint32_t)ends;
+
+        if (top >= bottom)
+        {
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&deque->ends, &ends, packEnds(top + 1, bottom),
+            memory_order_relaxed, memory_order_relaxed))
+        {
+            *test = deque->indices[top];
+            return true;
+        }
+    }
+}
+
+static void commitFinished(Commits* commits)
+{
+    while (commits->next < commits->count
+        && atomic_load_explicit(&commits->finished[commits->next], memory_order_acquire))
+    {
+        int test = commits->next++;
+
+        atomic_fetch_sub_explicit(&commits->pending, 1, memory_order_relaxed);
+        unitTestCaptureCommit(commits->captures[test]);
+        commits->captures[test] = NULL;
+        if (commits->reporting)
+        {
+            unitTestReportTest(&commits->tests[test], &commits->metrics[test]);
+        }
+    }
+    if (commits->next < commits->count && commits->tests[commits->next].serial)
+    {
+        atomic_store_explicit(&commits->blocked, true, memory_order_relaxed);
+    }
+}
+
+static void runOne(Runner* runner, int test)
+{
+    MetricsMark mark;
+
+    runner->captures[test] = unitTestCaptureBegin();
+    markMetrics(&mark);
+    runner->tests[test].func();
+    takeMetrics(&mark, &runner->metrics[test]);
+    unitTestCaptureEnd();
+
+    atomic_fetch_add_explicit(&runner->commits.pending, 1, memory_order_relaxed);
+    atomic_store_explicit(&runner->commits.finished[test], true, memory_order_release);
+    for (;;)
+    {
+        int next;
+
+        if (mtx_trylock(&runner->commitLock) != thrd_success)
+        {
+            if (atomic_load_explicit(&runner->commits.pending, memory_order_relaxed) <= RUNNER_MAX_PENDING
+                || atomic_load_explicit(&runner->commits.blocked, memory_order_relaxed))
+            {
+                break;
+            }
+            mtx_lock(&runner->commitLock);
+        }
+
+        commitFinished(&runner->commits);
+        next = runner->commits.next;
+        mtx_unlock(&runner->commitLock);
+
+        // A test finished while we held the lock.
+        if (next == runner->commits.count
+            || !atomic_load_explicit(&runner->commits.finished[next], memory_order_acquire))
+        {
+            break;
+        }
+    }
+}
+
+// The deque whose next test comes first in tests[], or NULL if all are
+// empty.
+static Deque* earliestDeque(Runner* runner)
+{
+    Deque* earliest = NULL;
+    int earliestTest = 0;
+
+    for (int w = 0; w < runner->workers; w++)
+    {
+        Deque* deque = &runner->deques[w];
+        uint64_t ends = atomic_load_explicit(&deque->ends, memory_order_relaxed);
+        uint32_t top = (uint32_t)(ends >> 32);
+        uint32_t bottom = (uint32_t)ends;
+
+        if (top < bottom && (!earliest || deque->indices[bottom - 1] < earliestTest))
+        {
+            earliest = deque;
+            earliestTest = deque->indices[bottom - 1];
+        }
+    }
+    return earliest;
+}
+
+static bool nextTest(Runner* runner, int self, int* test)
+{
+    // Ahead of the commits: run the first test not yet started, wherever
+    // it is, as it may be what they wait on.  Far ahead, the test they wait
+    // on is already running, so wait for it rather than pile up results.
+    int pending;
+
+    while ((pending = atomic_load_explicit(&runner->commits.pending, memory_order_relaxed)) > RUNNER_MAX_PENDING
+        && !atomic_load_explicit(&runner->commits.blocked, memory_order_relaxed))
+    {
+        Deque* earliest = earliestDeque(runner);
+
+        if (!earliest)
+        {
+            break;
+        }
+        if (pending <= 2 * RUNNER_MAX_PENDING && popBottom(earliest, test))
+        {
+            return true;
+        }
+        thrd_yield();
+    }
+    if (popBottom(&runner->deques[self], test))
+    {
+        return true;
+    }
+
+    // Out of work: take from the others, starting with the next worker
+    // along so thieves spread out.
+    for (int tries = 1; tries < runner->workers; tries++)
+    {
+        if (stealTop(&runner->deques[(self + tries) % runner->workers], test))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int workerMain(void* arg)
+{
+    Worker* worker = arg;
+    int test;
+
+    while (nextTest(worker->runner, worker->index, &test))
+    {
+        runOne(worker->runner, test);
+    }
+    return 0;
+}
+
+// splitmix64: a good spread from any seed, including 0.
+static uint64_t nextRandom(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void unitTestRegister(const char* name, UnitTestFunc func, bool serial)
+{
+    if (itsRegisteredCount == itsRegisteredCapacity)
+    {
+        int capacity = itsRegisteredCapacity ? itsRegisteredCapacity * 2 : 64;
+        UnitTestCase* grown = realloc(itsRegistered, sizeof(UnitTestCase) * capacity);
+
+        if (!grown)
+        {
+            return;
+        }
+        itsRegistered = grown;
+        itsRegisteredCapacity = capacity;
+    }
+    itsRegistered[itsRegisteredCount].name = name;
+    itsRegistered[itsRegisteredCount].func = func;
+    itsRegistered[itsRegisteredCount].serial = serial;
+    itsRegisteredCount++;
+}
+
+const UnitTestCase* unitTestRegistered(int* count)
+{
+    *count = itsRegisteredCount;
+    return itsRegistered;
+}
+
+bool unitTestGlobMatch(const char* pattern, const char* name)
+{
+    const char* star = NULL;
+    const char* resume = NULL;
+
+    // On a mismatch, let the last * take one more character and retry;
+    // earlier stars never need to, so this is linear in practice.
+    while (*name)
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = name;
+        }
+        else if (*pattern == '?' || *pattern == *name)
+        {
+            pattern++;
+            name++;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            name = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == 0;
+}
+
+int unitTestSelect(const UnitTestCase* tests, int count, const UnitTestSelection* selection,
+    UnitTestCase* selected)
+{
+    int matched = 0;
+    int kept = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        bool include = true;
+        bool exclude = false;
+
+        for (int f = 0; f < selection->filterCount; f++)
+        {
+            if (selection->filters[f][0] != '-')
+            {
+                include = false;
+                break;
+            }
+        }
+        for (int f = 0; f < selection->filterCount; f++)
+        {
+            const char* filter = selection->filters[f];
+
+            if (filter[0] == '-')
+            {
+                exclude = exclude || unitTestGlobMatch(filter + 1, tests[i].name);
+            }
+            else
+            {
+                include = include || unitTestGlobMatch(filter, tests[i].name);
+            }
+        }
+        if (!include || exclude)
+        {
+            continue;
+        }
+        if (selection->shards <= 1 || matched % selection->shards == selection->shard)
+        {
+            selected[kept++] = tests[i];
+        }
+        matched++;
+    }
+
+    if (selection->shuffle)
+    {
+        uint64_t state = selection->seed;
+
+        for (int i = kept - 1; i > 0; i--)
+        {
+            int j = (int)(nextRandom(&state) % (uint64_t)(i + 1));
+            UnitTestCase swap = selected[i];
+
+            selected[i] = selected[j];
+            selected[j] = swap;
+        }
+    }
+    return kept;
+}
+
+void unitTestRun(const UnitTestCase* tests, int count, int workers, UnitTestRunStats* stats,
+    UnitTestMetrics* metrics)
+{
+    Runner runner = { 0 };
+    Worker pool[RUNNER_MAX_WORKERS];
+    thrd_t threads[RUNNER_MAX_WORKERS];
+    bool started[RUNNER_MAX_WORKERS] = { false };
+    int* order = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int parallel = 0;
+    double start = now();
+    double serialSeconds = 0.0;
+    UnitTestRunStats ownStats;
+    bool locked;
+    bool reporting = atomic_fetch_add(&itsRunDepth, 1) == 0 && unitTestReporting();
+
+    if (!stats)
+    {
+        stats = &ownStats;
+    }
+    if (reporting)
+    {
+        unitTestReportBegin(count);
+    }
+
+    runner.tests = tests;
+    runner.captures = calloc(count > 0 ? count : 1, sizeof(UnitTestCapture*));
+    runner.metrics = calloc(count > 0 ? count : 1, sizeof(UnitTestMetrics));
+    runner.commits.finished = calloc(count > 0 ? count : 1, sizeof(atomic_bool));
+    locked = mtx_init(&runner.commitLock, mtx_plain) == thrd_success;
+    if (!order || !runner.captures || !runner.metrics || !runner.commits.finished || !locked)
+    {
+        UnitTestMetrics none = { 0 };
+
+        // No room to run them apart; run them one by one.
+        for (int i = 0; i < count; i++)
+        {
+            tests[i].func();
+            if (reporting)
+            {
+                unitTestReportTest(&tests[i], &none);
+            }
+        }
+        if (metrics)
+        {
+            memset(metrics, 0, sizeof(UnitTestMetrics) * count);
+        }
+        if (locked)
+        {
+            mtx_destroy(&runner.commitLock);
+        }
+        free(order);
+        free(runner.captures);
+        free(runner.metrics);
+        free((void*)runner.commits.finished);
+        stats->tests = count;
+        stats->workers = 1;
+        stats->wallSeconds = now() - start;
+        stats->serialSeconds = stats->wallSeconds;
+        stats->crashed = 0;
+        stats->timedOut = 0;
+        if (reporting)
+        {
+            unitTestReportEnd(stats);
+        }
+        atomic_fetch_sub(&itsRunDepth, 1);
+        return;
+    }
+    runner.commits.tests = tests;
+    runner.commits.reporting = reporting;
+    runner.commits.captures = runner.captures;
+    runner.commits.metrics = runner.metrics;
+    runner.commits.count = count;
+
+    if (workers <= 0)
+    {
+        workers = coreCount();
+    }
+    if (workers > RUNNER_MAX_WORKERS)
+    {
+        workers = RUNNER_MAX_WORKERS;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        parallel += !tests[i].serial;
+    }
+    if (workers > parallel)
+    {
+        workers = parallel > 0 ? parallel : 1;
+    }
+    runner.workers = workers;
+
+    // Worker w takes the w'th test and every workers'th after it, with the
+    // first at the bottom, so the workers move through tests[] side by
+    // side and few finished tests wait on an earlier one to be committed.
+    for (int w = 0, filled = 0; w < workers; w++)
+    {
+        int first = filled;
+
+        for (int i = 0, seen = 0; i < count; i++)
+        {
+            if (!tests[i].serial && seen++ % workers == w)
+            {
+                order[filled++] = i;
+            }
+        }
+        for (int i = first, j = filled - 1; i < j; i++, j--)
+        {
+            int swap = order[i];
+
+            order[i] = order[j];
+            order[j] = swap;
+        }
+        runner.deques[w].indices = order + first;
+        atomic_init(&runner.deques[w].ends, packEnds(0, (uint32_t)(filled - first)));
+    }
+
+    for (int w = 0; w < workers; w++)
+    {
+        pool[w].runner = &runner;
+        pool[w].index = w;
+    }
+    for (int w = 1; w < workers; w++)
+    {
+        // A worker that won't start leaves its tests to be stolen.
+        started[w] = thrd_create(&threads[w], workerMain, &pool[w]) == thrd_success;
+    }
+    workerMain(&pool[0]);
+    for (int w = 1; w < workers; w++)
+    {
+        if (started[w])
+        {
+            thrd_join(threads[w], NULL);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (tests[i].serial)
+        {
+            runOne(&runner, i);
+        }
+    }
+
+    // Any a worker left to a holder of the lock that had already looked.
+    commitFinished(&runner.commits);
+    for (int i = 0; i < count; i++)
+    {
+        serialSeconds += runner.metrics[i].wallSeconds;
+    }
+
+    stats->tests = count;
+    stats->workers = workers;
+    stats->wallSeconds = now() - start;
+    stats->serialSeconds = serialSeconds;
+    stats->crashed = 0;
+    stats->timedOut = 0;
+    if (reporting)
+    {
+        unitTestReportEnd(stats);
+    }
+    if (metrics)
+    {
+        memcpy(metrics, runner.metrics, sizeof(UnitTestMetrics) * count);
+    }
+    mtx_destroy(&runner.commitLock);
+    free(order);
+    free(runner.captures);
+    free(runner.metrics);
+    free((void*)runner.commits.finished);
+    atomic_fetch_sub(&itsRunDepth, 1);
+}
+
+#ifndef _WIN32
+
+// What an isolated child passes back for the test in hand.  The child
+// stores a record and then the count; the parent reads them once the
+// child reports the test done, or has died.  The metrics are only read
+// for a test that's done.
+typedef struct IsolatedSlot
+{
+    UnitTestMetrics metrics;
+    atomic_int count;
+    atomic_bool overflow;
+    // Results there was no room for.
+    atomic_int droppedPasses;
+    atomic_int droppedFailures;
+    UnitTestOutput records[ISOLATED_MAX_RESULTS];
+} IsolatedSlot;
+
+typedef struct Child
+{
+    // -1 if there is none.
+    pid_t pid;
+    // The parent writes the index of each test to run to the command pipe,
+    // and the child writes it back to the done pipe once it has run.
+    int commandFd;
+    int doneFd;
+    // In hand, or -1.
+    int test;
+    double started;
+} Child;
+
+typedef struct Isolation
+{
+    const UnitTestCase* tests;
+    IsolatedSlot* slots;
+    UnitTestCapture** captures;
+    UnitTestMetrics* metrics;
+    int children;
+    Child child[RUNNER_MAX_WORKERS];
+    Commits commits;
+} Isolation;
+
+// Reporter for the log of a child: passes each result back.
+static void passBack(void* context, const UnitTestOutput* output)
+{
+    IsolatedSlot* slot = context;
+    int count = atomic_load_explicit(&slot->count, memory_order_relaxed);
+    int room = output->result == UNIT_TEST_FAIL ? ISOLATED_MAX_RESULTS
+        : ISOLATED_MAX_RESULTS - ISOLATED_FAILURE_RESERVE;
+
+    if (count < room)
+    {
+        slot->records[count] = *output;
+        atomic_store_explicit(&slot->count, count + 1, memory_order_release);
+        return;
+    }
+    if (output->result == UNIT_TEST_PASS)
+    {
+        atomic_fetch_add_explicit(&slot->droppedPasses, 1, memory_order_relaxed);
+    }
+    else if (output->result == UNIT_TEST_FAIL)
+    {
+        atomic_fetch_add_explicit(&slot->droppedFailures, 1, memory_order_relaxed);
+    }
+    else
+    {
+        ;  // Benchmarks count as neither
+    }
+    atomic_store_explicit(&slot->overflow, true, memory_order_relaxed);
+}
+
+static void childMain(IsolatedSlot* slot, const UnitTestCase* tests, int commandFd, int doneFd)
+{
+    UnitTestOutput output;
+    int test;
+
+    // Results the parent hadn't read when it forked are its own.
+    unitTestSetMemoryCap(0, NULL, NULL);
+    while (unitTestGetEntry(&output))
+    {
+        ;
+    }
+
+    // With no room allowed, the log streams to the reporter each time a
+    // chunk of results fills.
+    unitTestSetMemoryCap(0, passBack, slot);
+    while (read(commandFd, &test, sizeof(test)) == sizeof(test))
+    {
+        MetricsMark mark;
+
+        markMetrics(&mark);
+        tests[test].func();
+        takeMetrics(&mark, &slot->metrics);
+        while (unitTestGetEntry(&output))
+        {
+            passBack(slot, &output);
+        }
+        fflush(NULL);
+        if (write(doneFd, &test, sizeof(test)) != sizeof(test))
+        {
+            break;
+        }
+    }
+    _exit(0);
+}
+
+static bool startChild(Isolation* isolation, int index)
+{
+    Child* child = &isolation->child[index];
+    int command[2];
+    int done[2];
+
+    child->pid = -1;
+    child->test = -1;
+    if (pipe(command) != 0)
+    {
+        return false;
+    }
+    if (pipe(done) != 0)
+    {
+        close(command[0]);
+        close(command[1]);
+        return false;
+    }
+
+    // Anything buffered would be written again by the child.
+    fflush(NULL);
+    child->pid = fork();
+    if (child->pid == 0)
+    {
+        // Holding the others' pipes open would hide their ends from them.
+        for (int i = 0; i < isolation->children; i++)
+        {
+            if (i != index && isolation->child[i].pid > 0)
+            {
+                close(isolation->child[i].commandFd);
+                close(isolation->child[i].doneFd);
+            }
+        }
+        close(command[1]);
+        close(done[0]);
+        childMain(&isolation->slots[index], isolation->tests, command[0], done[1]);
+    }
+    close(command[0]);
+    close(done[1]);
+    if (child->pid < 0)
+    {
+        close(command[1]);
+        close(done[0]);
+        return false;
+    }
+    child->commandFd = command[1];
+    child->doneFd = done[0];
+    return true;
+}
+
+// Closes a child's pipes and waits for it to exit, killing it first if
+// asked.  Returns its wait status.
+static int endChild(Child* child, bool killFirst)
+{
+    int status = 0;
+
+    if (killFirst)
+    {
+        kill(child->pid, SIGKILL);
+    }
+    close(child->commandFd);
+    close(child->doneFd);
+    while (waitpid(child->pid, &status, 0) < 0 && errno == EINTR)
+    {
+        ;
+    }
+    child->pid = -1;
+    return status;
+}
+
+static bool assignTest(Isolation* isolation, int index, int test)
+{
+    Child* child = &isolation->child[index];
+    IsolatedSlot* slot = &isolation->slots[index];
+
+    atomic_store_explicit(&slot->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->overflow, false, memory_order_relaxed);
+    atomic_store_explicit(&slot->droppedPasses, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->droppedFailures, 0, memory_order_relaxed);
+    if (write(child->commandFd, &test, sizeof(test)) != sizeof(test))
+    {
+        return false;
+    }
+    child->test = test;
+    child->started = now();
+    return true;
+}
+
+// Captures what the child in hand passed back for its test, and a failure
+// saying why it didn't finish, if it didn't.
+static void collectTest(Isolation* isolation, int index, const char* failure)
+{
+    Child* child = &isolation->child[index];
+    IsolatedSlot* slot = &isolation->slots[index];
+    int test = child->test;
+    int count = atomic_load_explicit(&slot->count, memory_order_acquire);
+
+    if (failure)
+    {
+        isolation->metrics[test].wallSeconds = now() - child->started;
+    }
+    else
+    {
+        isolation->metrics[test] = slot->metrics;
+    }
+    isolation->captures[test] = unitTestCaptureBegin();
+    for (int i = 0; i < count; i++)
+    {
+        UnitTestOutput output = slot->records[i];
+
+        output.overflow = output.overflow
+            || (i == count - 1 && atomic_load_explicit(&slot->overflow, memory_order_relaxed));
+        unitTestAddOutput(&output);
+    }
+    unitTestAddCounts(atomic_load_explicit(&slot->droppedPasses, memory_order_relaxed),
+        atomic_load_explicit(&slot->droppedFailures, memory_order_relaxed));
+    if (failure)
+    {
+        UnitTestOutput output = { UNIT_TEST_FAIL, false, isolation->tests[test].name, 0, "" };
+
+        snprintf(output.msg, sizeof(output.msg), "%s", failure);
+        unitTestAddOutput(&output);
+    }
+    unitTestCaptureEnd();
+    child->test = -1;
+
+    isolation->commits.finished[test] = true;
+    atomic_fetch_add_explicit(&isolation->commits.pending, 1, memory_order_relaxed);
+    commitFinished(&isolation->commits);
+}
+
+void unitTestRunIsolated(const UnitTestCase* tests, int count, int children, double timeoutSeconds,
+    UnitTestRunStats* stats, UnitTestMetrics* metrics)
+{
+    Isolation isolation = { 0 };
+    struct pollfd polls[RUNNER_MAX_WORKERS];
+    int pollChild[RUNNER_MAX_WORKERS];
+    struct sigaction ignore = { 0 };
+    struct sigaction saved;
+    int* order = malloc(sizeof(int) * (count > 0 ? count : 1));
+    int parallel = 0;
+    int next = 0;
+    int finished = 0;
+    int crashed = 0;
+    int timedOut = 0;
+    double start = now();
+    double serialSeconds = 0.0;
+    UnitTestRunStats ownStats;
+
+    if (!stats)
+    {
+        stats = &ownStats;
+    }
+    if (children <= 0)
+    {
+        children = coreCount();
+    }
+    if (children > RUNNER_MAX_WORKERS)
+    {
+        children = RUNNER_MAX_WORKERS;
+    }
+    if (children > count)
+    {
+        children = count > 0 ? count : 1;
+    }
+
+    isolation.tests = tests;
+    isolation.children = children;
+    isolation.captures = calloc(count > 0 ? count : 1, sizeof(UnitTestCapture*));
+    isolation.metrics = calloc(count > 0 ? count : 1, sizeof(UnitTestMetrics));
+    isolation.commits.finished = calloc(count > 0 ? count : 1, sizeof(atomic_bool));
+    isolation.slots = mmap(NULL, sizeof(IsolatedSlot) * children, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (!order || !isolation.captures || !isolation.metrics || !isolation.commits.finished
+        || isolation.slots == MAP_FAILED)
+    {
+        // No room to run them apart; run them here.
+        free(order);
+        free(isolation.captures);
+        free(isolation.metrics);
+        free((void*)isolation.commits.finished);
+        if (isolation.slots != MAP_FAILED)
+        {
+            munmap(isolation.slots, sizeof(IsolatedSlot) * children);
+        }
+        unitTestRun(tests, count, 1, stats, metrics);
+        return;
+    }
+
+    isolation.commits.tests = tests;
+    isolation.commits.reporting = unitTestReporting();
+    isolation.commits.captures = isolation.captures;
+    isolation.commits.metrics = isolation.metrics;
+    isolation.commits.count = count;
+    unitTestReportBegin(count);
+
+    // A child may die with a test index unread in its pipe.
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &saved);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!tests[i].serial)
+        {
+            order[parallel++] = i;
+        }
+    }
+    for (int i = 0, j = parallel; i < count; i++)
+    {
+        if (tests[i].serial)
+        {
+            order[j++] = i;
+        }
+    }
+    for (int c = 0; c < children; c++)
+    {
+        startChild(&isolation, c);
+    }
+
+    while (finished < count)
+    {
+        int busy = 0;
+        int alive = 0;
+        int polled = 0;
+        int waitMillis = -1;
+
+        for (int c = 0; c < children; c++)
+        {
+            busy += isolation.child[c].test >= 0;
+        }
+
+        // Hand out tests to idle children; serial ones only once nothing
+        // else is running.
+        for (int c = 0; c < children && next < count; c++)
+        {
+            Child* child = &isolation.child[c];
+
+            if (child->pid < 0 || child->test >= 0)
+            {
+                continue;
+            }
+            if (next >= parallel && busy > 0)
+            {
+                break;
+            }
+            if (assignTest(&isolation, c, order[next]))
+            {
+                next++;
+                busy++;
+            }
+            else
+            {
+                // Died idle; nothing of a test to report.
+                endChild(child, false);
+                startChild(&isolation, c);
+            }
+        }
+
+        for (int c = 0; c < children; c++)
+        {
+            Child* child = &isolation.child[c];
+
+            alive += child->pid > 0;
+            if (child->test >= 0)
+            {
+                polls[polled].fd = child->doneFd;
+                polls[polled].events = POLLIN;
+                polls[polled].revents = 0;
+                pollChild[polled++] = c;
+                if (timeoutSeconds > 0.0)
+                {
+                    double left = child->started + timeoutSeconds - now();
+                    int millis = left > 0.0 ? (int)(left * 1000.0) + 1 : 0;
+
+                    if (waitMillis < 0 || millis < waitMillis)
+                    {
+                        waitMillis = millis;
+                    }
+                }
+            }
+        }
+        if (polled == 0)
+        {
+            if (alive == 0)
+            {
+                // No children could be started; fail what's left.
+                for (; next < count; next++, finished++)
+                {
+                    UnitTestOutput output = { UNIT_TEST_FAIL, false, tests[order[next]].name, 0, "" };
+
+                    snprintf(output.msg, sizeof(output.msg), "%s: not run, no child process", tests[order[next]].name);
+                    isolation.captures[order[next]] = unitTestCaptureBegin();
+                    unitTestAddOutput(&output);
+                    unitTestCaptureEnd();
+                    isolation.commits.finished[order[next]] = true;
+                    atomic_fetch_add_explicit(&isolation.commits.pending, 1, memory_order_relaxed);
+                }
+                commitFinished(&isolation.commits);
+            }
+            continue;
+        }
+
+        if (poll(polls, (nfds_t)polled, waitMillis) < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        for (int p = 0; p < polled; p++)
+        {
+            int c = pollChild[p];
+            Child* child = &isolation.child[c];
+            int test;
+
+            if (polls[p].revents == 0)
+            {
+                if (timeoutSeconds > 0.0 && now() - child->started >= timeoutSeconds)
+                {
+                    char why[UNIT_TEST_MESSAGE_LEN];
+
+                    snprintf(why, sizeof(why), "%s: timed out after %.1f s", tests[child->test].name, timeoutSeconds);
+                    collectTest(&isolation, c, why);
+                    endChild(child, true);
+                    startChild(&isolation, c);
+                    timedOut++;
+                    finished++;
+                }
+                continue;
+            }
+
+            if (read(child->doneFd, &test, sizeof(test)) == sizeof(test) && test == child->test)
+            {
+                collectTest(&isolation, c, NULL);
+            }
+            else
+            {
+                char why[UNIT_TEST_MESSAGE_LEN];
+                int status = endChild(child, true);
+
+                if (WIFSIGNALED(status))
+                {
+                    snprintf(why, sizeof(why), "%s: killed by signal %d (%s)", tests[child->test].name,
+                        WTERMSIG(status), strsignal(WTERMSIG(status)));
+                }
+                else
+                {
+                    snprintf(why, sizeof(why), "%s: exited with status %d", tests[child->test].name,
+                        WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+                }
+                collectTest(&isolation, c, why);
+                startChild(&isolation, c);
+                crashed++;
+            }
+            finished++;
+        }
+    }
+
+    for (int c = 0; c < children; c++)
+    {
+        if (isolation.child[c].pid > 0)
+        {
+            endChild(&isolation.child[c], false);
+        }
+    }
+    sigaction(SIGPIPE, &saved, NULL);
+
+    // Any left behind a test that never finished, if poll() failed.
+    for (int i = 0; i < count; i++)
+    {
+        isolation.commits.finished[i] = true;
+        serialSeconds += isolation.metrics[i].wallSeconds;
+    }
+    commitFinished(&isolation.commits);
+
+    stats->tests = count;
+    stats->workers = children;
+    stats->wallSeconds = now() - start;
+    stats->serialSeconds = serialSeconds;
+    stats->crashed = crashed;
+    stats->timedOut = timedOut;
+    unitTestReportEnd(stats);
+    if (metrics)
+    {
+        memcpy(metrics, isolation.metrics, sizeof(UnitTestMetrics) * count);
+    }
+    munmap(isolation.slots, sizeof(IsolatedSlot) * children);
+    free(order);
+    free(isolation.captures);
+    free(isolation.metrics);
+    free((void*)isolation.commits.finished);
+}
+#endif
+
+double unitTestSpeedup(const UnitTestRunStats* stats)
+{
+    return stats->wallSeconds > 0.0 ? stats->serialSeconds / stats->wallSeconds : 1.0;
+}
@@ -0,0 +1,186 @@
+#ifndef UNITTESTRUNNER_H
+#define UNITTESTRUNNER_H
+
+/************************************************
+* (c) Copyright TBD
+* 
+* Name: UnitTestRunner.h
+* 
+* Description: Runs a list of unit tests on a pool of threads
+* 
+* Revision History:
+* 
+* Target:
+* 
+*/
+
+// INCLUDE FILES
+#include <stdbool.h>
+#include <stdint.h>
+#include "UnitTest.h"
+
+// DEFINE AND TYPE DECLARATIONS
+
+typedef void (*UnitTestFunc)(void);
+
+typedef struct UnitTestCase
+{
+    const char* name;
+    UnitTestFunc func;
+    // Not thread-safe: run on the calling thread once the others are done,
+    // with nothing else running.
+    bool serial;
+} UnitTestCase;
+
+typedef struct UnitTestRunStats
+{
+    int tests;
+    int workers;
+    // Time the run took, and the sum of the times the tests took, which
+    // is what running them one after another would have taken.
+    double wallSeconds;
+    double serialSeconds;
+    // Tests whose process died, or was killed at the timeout, in an
+    // isolated run.
+    int crashed;
+    int timedOut;
+} UnitTestRunStats;
+
+typedef struct UnitTestSelection
+{
+    // Glob patterns, with * and ?.  A test is selected if its name matches
+    // any pattern not starting with '-', or there are none, and matches
+    // no pattern that does, less the '-'.
+    const char* const* filters;
+    int filterCount;
+    // Keeps the shard'th of shards slices, counting from 0, taking every
+    // shards'th test from those the filters select in registration order,
+    // so every machine sees the same split.  shards of 0 or 1 keeps all.
+    int shard;
+    int shards;
+    // Runs the selected tests in an order shuffled by seed.
+    bool shuffle;
+    uint64_t seed;
+} UnitTestSelection;
+
+// TEST(name) { ... } defines a test and registers it before main() runs,
+// in the order the definitions are seen: by file within a translation
+// unit, and by link order across them.  TEST_SERIAL(name) defines one
+// that isn't safe to run alongside others.
+#define TEST(name) UNIT_TEST_DEFINE(name, false)
+#define TEST_SERIAL(name) UNIT_TEST_DEFINE(name, true)
+
+#if defined(_MSC_VER)
+#pragma section(".CRT$XCU", read)
+#if defined(_M_IX86)
+#define UNIT_TEST_SYMBOL_PREFIX "_"
+#else
+#define UNIT_TEST_SYMBOL_PREFIX ""
+#endif
+#define UNIT_TEST_REGISTER(name, func, serial) \
+    static void unitTestRegister_##name(void) { unitTestRegister(#name, func, serial); } \
+    __declspec(allocate(".CRT$XCU")) void (*unitTestRegisterPtr_##name)(void) = unitTestRegister_##name; \
+    __pragma(comment(linker, "/include:" UNIT_TEST_SYMBOL_PREFIX "unitTestRegisterPtr_" #name))
+#else
+#define UNIT_TEST_REGISTER(name, func, serial) \
+    __attribute__((constructor)) static void unitTestRegister_##name(void) { unitTestRegister(#name, func, serial); }
+#endif
+
+#define UNIT_TEST_DEFINE(name, serial) \
+    static void name(void); \
+    UNIT_TEST_REGISTER(name, name, serial) \
+    static void name(void)
+
+// What one test cost.
+typedef struct UnitTestMetrics
+{
+    double wallSeconds;
+    // CPU time of the thread that ran the test.
+    double cpuSeconds;
+    // Calls to malloc(), calloc() and realloc() on that thread, and the
+    // bytes they asked for, not counting the harness's own; counted on
+    // Linux with glibc only, see UnitTestAlloc.c.
+    uint64_t allocations;
+    uint64_t allocatedBytes;
+    // Growth of the process's peak resident set over the test, in KiB.
+    // The peak is the process's, so in a run on several threads a test's
+    // figure may include what others did alongside it; isolated runs give
+    // each test's own.  Not measured on Windows.
+    long peakRssDeltaKb;
+} UnitTestMetrics;
+
+// PUBLIC FUNCTION PROTOTYPES
+
+// Adds a test to those returned by unitTestRegistered().  TEST() calls
+// this.
+void unitTestRegister(const char* name, UnitTestFunc func, bool serial);
+
+// The registered tests, in registration order.
+const UnitTestCase* unitTestRegistered(int* count);
+
+// Matches name against a glob pattern, with * for any run of characters
+// and ? for any one.
+bool unitTestGlobMatch(const char* pattern, const char* name);
+
+// Copies to selected, which must have room for count, the tests that
+// selection picks from tests.  Returns how many.
+int unitTestSelect(const UnitTestCase* tests, int count, const UnitTestSelection* selection,
+    UnitTestCase* selected);
+
+// Runs count tests on workers threads, or one per core for 0, the calling
+// thread among them.  Each worker starts with its share of the tests and
+// takes from the others once it runs out; while many results wait to be
+// committed, workers run the earliest test not yet started instead.  The
+// results of each test are captured on the thread that runs it and
+// committed to the log in the order of tests[], once it and every test
+// before it have run, so unitTestGetEntry() returns the same results in
+// the same order as running them one by one would.  With reports added
+// (see UnitTestReport.h), each test's results go to them as it is
+// committed; otherwise they are left in the log for the caller.  A run
+// started from a test of another reports nothing itself: its results are
+// left in the log, and reported with the enclosing run's next test.
+// stats may be NULL, and so may metrics; if not, it gets the metrics of
+// each test, in the order of tests[].
+void unitTestRun(const UnitTestCase* tests, int count, int workers, UnitTestRunStats* stats,
+    UnitTestMetrics* metrics);
+
+#ifndef _WIN32
+// Runs each test in a child process, so a test that crashes or hangs
+// costs only its own results.  children processes, or one per core for
+// 0, are forked at the start and run test after test; the results of each
+// come back through shared memory, and are committed to the log in the
+// order of tests[] once all have run.  A child that takes longer than
+// timeoutSeconds over a test, if not 0, is killed.  A test whose child
+// dies or is killed fails with a message saying why, after whatever
+// results it had passed back, and a new child takes the dead one's
+// place.  Serial tests run one at a time once the others are done.
+// Results are committed and reported in order as tests finish, as for
+// unitTestRun().
+//
+// A child passes its results back a chunk at a time as it records them,
+// and the rest when the test returns, so a crash loses the results of the
+// chunk in hand.  Each child keeps the state the parent had when it was
+// forked, not what earlier tests did in other children.
+// A test's results past the first thousand or so come back as counts
+// only, except its failures, so the pass and fail counts are whole and a
+// failure at the end of a long test is still reported.
+// stats and metrics may be NULL, as for unitTestRun(); a test whose child
+// died has only its wall time.
+void unitTestRunIsolated(const UnitTestCase* tests, int count, int children, double timeoutSeconds,
+    UnitTestRunStats* stats, UnitTestMetrics* metrics);
+#endif
+
+// Allocations and bytes allocated so far on this thread.  UnitTestAlloc.c
+// defines this.
+void unitTestAllocCounts(uint64_t* allocations, uint64_t* bytes);
+
+// Brackets the harness's own allocations on this thread, such as the
+// chunks and string copies that hold a test's results, so they aren't
+// counted against the test.  Calls nest.
+void unitTestAllocHarnessBegin(void);
+void unitTestAllocHarnessEnd(void);
+
+// Wall-clock speedup of a run over running its tests one by one.
+double unitTestSpeedup(const UnitTestRunStats* stats);
+
+#endif
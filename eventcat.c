@@ -0,0 +1,474 @@
+/*
+* @file eventcat.c
+*
+* Prints an EventLog stream as it arrives.
+*
+* usage: eventcat [-f] [-r] [-o hold] [-b baud] [-l level] [-s source]... [-t type]... [path]
+*
+*   path      a tty, pty, fifo or capture file.  Standard input if omitted.
+*   -f        keep reading a capture file named by path as it grows,
+*             like tail -f
+*   -r        expand EVENT_REPEATED back into the events it stands for
+*   -o hold   put events back in timestamp order, as sent from priority
+*             lanes, holding each up to hold microseconds
+*   -b baud   line rate when path names a tty (default 115200)
+*   -l level  only show this level and above: INFO, WARNING, ERROR or 0-2
+*   -s source only show this source; may be repeated
+*   -t type   only show this event ID; may be repeated
+*
+* Input is read non-blocking and the tool sleeps in poll() whenever there
+* is nothing to read.  Growing files are watched with inotify.  Each batch
+* of frames is formatted into one buffer and written with a single write(),
+* so a frame is on screen as soon as the read that completed it returns.
+*
+* Only a tty named by path is set up as a raw serial line; standard input
+* is left as it is apart from being made non-blocking.  Both are put back
+* as they were on exit and on SIGINT or SIGTERM.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "EventLog.h"
+#include "EventQuery.h"
+
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+static char itsOutput[OUTPUT_BUFFER_SIZE];
+static size_t itsOutputLen;
+
+static EventReorder itsReorder;
+static bool itsReordering;
+
+// With -r, types are filtered after expanding, since the expander has to
+// see every event from a source to know what an EVENT_REPEATED repeats.
+static uint32_t itsTypes[256 / 32];
+static bool itsFilteringTypes;
+
+// The input's settings before we changed them, put back on the way out.
+static int itsInputFd = -1;
+static int itsSavedFlags = -1;
+static struct termios itsSavedTty;
+static bool itsTtySaved;
+
+static void flushOutput(void);
+
+// Formats one event into the output buffer, flushing it first if full.
+static void printEventLine(void* context, const EventData* event)
+{
+    (void)context;
+    if (sizeof(itsOutput) - itsOutputLen < EVENT_FORMAT_MAX)
+    {
+        flushOutput();
+    }
+    itsOutputLen += eventFormat(event, itsOutput + itsOutputLen, EVENT_FORMAT_MAX);
+}
+
+static void showEvent(void* context, const EventData* event)
+{
+    if (itsReordering)
+    {
+        eventReorderPush(&itsReorder, event, printEventLine, context);
+    }
+    else
+    {
+        printEventLine(context, event);
+    }
+}
+
+static void showExpanded(void* context, const EventData* event)
+{
+    uint8_t type = (uint8_t)event->eventID;
+
+    if (itsFilteringTypes && (itsTypes[type >> 5] & (1u << (type & 31))) == 0)
+    {
+        return;
+    }
+    showEvent(context, event);
+}
+
+// Only calls that are safe in a signal handler.
+static void restoreInput(void)
+{
+    if (itsTtySaved)
+    {
+        tcsetattr(itsInputFd, TCSANOW, &itsSavedTty);
+    }
+    if (itsSavedFlags >= 0)
+    {
+        fcntl(itsInputFd, F_SETFL, itsSavedFlags);
+    }
+}
+
+static void onSignal(int sig)
+{
+    restoreInput();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: eventcat [-f] [-r] [-o hold] [-b baud] [-l level] [-s source]... [-t type]... [path]\n");
+    exit(2);
+}
+
+static void flushOutput(void)
+{
+    size_t done = 0;
+
+    while (done < itsOutputLen)
+    {
+        ssize_t n = write(STDOUT_FILENO, itsOutput + done, itsOutputLen - done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+    itsOutputLen = 0;
+}
+
+static speed_t baudToSpeed(long baud)
+{
+    switch (baud)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return 0;
+    }
+}
+
+static void configureTty(int fd, long baud)
+{
+    struct termios tio;
+    speed_t speed = baudToSpeed(baud);
+
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return;
+    }
+    itsSavedTty = tio;
+    itsTtySaved = true;
+    cfmakeraw(&tio);
+    if (speed)
+    {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    else
+    {
+        fprintf(stderr, "eventcat: unsupported baud rate %ld, leaving line speed alone\n", baud);
+    }
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+static int parseLevel(const char* arg)
+{
+    if (strcasecmp(arg, "INFO") == 0)
+    {
+        return EVENT_INFO;
+    }
+    if (strcasecmp(arg, "WARNING") == 0)
+    {
+        return EVENT_WARNING;
+    }
+    if (strcasecmp(arg, "ERROR") == 0)
+    {
+        return EVENT_ERROR;
+    }
+    if (arg[0] >= '0' && arg[0] <= '2' && arg[1] == 0)
+    {
+        return arg[0] - '0';
+    }
+    usage();
+    return 0;
+}
+
+static int parseId(const char* arg)
+{
+    char* end;
+    long val = strtol(arg, &end, 0);
+
+    if (*end || val < 0 || val > 255)
+    {
+        usage();
+    }
+    return (int)val;
+}
+
+// Waits until fd has something to read.  For a growing regular file,
+// waits for it to be written to.  Returns false if there's nothing more
+// to wait for.
+static bool waitForInput(int fd, int watch)
+{
+    struct pollfd pfd;
+
+    pfd.fd = (watch >= 0) ? watch : fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    while (poll(&pfd, 1, -1) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+#ifdef __linux__
+    if (watch >= 0)
+    {
+        char events[4096];
+
+        // Only the wakeup matters, not which events woke us.
+        while (read(watch, events, sizeof(events)) > 0)
+        {
+            ;
+        }
+    }
+#endif
+    return (pfd.revents & (POLLIN | POLLHUP)) != 0 || watch >= 0;
+}
+
+int main(int argc, char** argv)
+{
+    static EventStream stream;
+    static EventRepeatExpander expander;
+    bool expand = false;
+    EventQuery query;
+    EventQueryTimeline timeline = { 0 };
+    bool follow = false;
+    bool anySource = false;
+    bool anyType = false;
+    long baud = 115200;
+    const char* path = NULL;
+    struct stat st;
+    int watch = -1;
+    int fd;
+    int opt;
+
+    eventQueryInit(&query);
+    while ((opt = getopt(argc, argv, "fro:b:l:s:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            follow = true;
+            break;
+        case 'r':
+            expand = true;
+            break;
+        case 'o':
+            eventReorderInit(&itsReorder, (uint32_t)strtoul(optarg, NULL, 10));
+            itsReordering = true;
+            break;
+        case 'b':
+            baud = strtol(optarg, NULL, 10);
+            break;
+        case 'l':
+            query.levels = (uint8_t)((0x7u << parseLevel(optarg)) & 0x7u);
+            break;
+        case 's':
+        {
+            int id = parseId(optarg);
+
+            if (!anySource)
+            {
+                memset(query.sources, 0, sizeof(query.sources));
+                anySource = true;
+            }
+            query.sources[id >> 5] |= 1u << (id & 31);
+            break;
+        }
+        case 't':
+        {
+            int id = parseId(optarg);
+
+            if (!anyType)
+            {
+                memset(query.types, 0, sizeof(query.types));
+                anyType = true;
+            }
+            query.types[id >> 5] |= 1u << (id & 31);
+            break;
+        }
+        default:
+            usage();
+        }
+    }
+    if (optind < argc)
+    {
+        path = argv[optind++];
+    }
+    if (optind < argc)
+    {
+        usage();
+    }
+    // Growth is watched by name, which standard input hasn't got.
+    if (follow && (!path || strcmp(path, "-") == 0))
+    {
+        fprintf(stderr, "eventcat: -f needs a path\n");
+        usage();
+    }
+    if (expand && anyType)
+    {
+        memcpy(itsTypes, query.types, sizeof(itsTypes));
+        memset(query.types, 0xFF, sizeof(query.types));
+        itsFilteringTypes = true;
+    }
+
+    atexit(restoreInput);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    if (path && strcmp(path, "-") != 0)
+    {
+        fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+        if (fd < 0)
+        {
+            perror(path);
+            return 1;
+        }
+        itsInputFd = fd;
+        if (isatty(fd))
+        {
+            configureTty(fd, baud);
+        }
+    }
+    else
+    {
+        // Standard input shares its file flags with whoever started us.
+        fd = STDIN_FILENO;
+        itsInputFd = fd;
+        itsSavedFlags = fcntl(fd, F_GETFL);
+        if (itsSavedFlags >= 0)
+        {
+            fcntl(fd, F_SETFL, itsSavedFlags | O_NONBLOCK);
+        }
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && follow)
+    {
+#ifdef __linux__
+        watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watch >= 0 && inotify_add_watch(watch, path, IN_MODIFY) < 0)
+        {
+            close(watch);
+            watch = -1;
+        }
+#endif
+        if (watch < 0)
+        {
+            fprintf(stderr, "eventcat: can't watch %s for growth\n", path);
+            follow = false;
+        }
+    }
+
+    eventStreamInit(&stream);
+    eventRepeatExpanderInit(&expander);
+    for (;;)
+    {
+        EventFrameView view;
+        size_t room;
+        char* space = eventStreamSpace(&stream, &room);
+        ssize_t n = read(fd, space, room);
+
+        if (n > 0)
+        {
+            eventStreamCommit(&stream, (size_t)n);
+            while (eventStreamNext(&stream, &view))
+            {
+                EventData event;
+
+                if (!eventQueryMatch(&query, &timeline, &view))
+                {
+                    continue;
+                }
+                event = eventFrameEvent(&view);
+                if (!event.valid)
+                {
+                    continue;
+                }
+                if (expand)
+                {
+                    eventRepeatExpand(&expander, &event, showExpanded, NULL);
+                }
+                else
+                {
+                    showEvent(NULL, &event);
+                }
+            }
+            // Keep draining while input is ready; flush once it isn't.
+            if ((size_t)n == room)
+            {
+                continue;
+            }
+            flushOutput();
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            flushOutput();
+            if (!waitForInput(fd, -1))
+            {
+                break;
+            }
+        }
+        else if (n == 0 && follow)
+        {
+            flushOutput();
+            if (!waitForInput(fd, watch))
+            {
+                break;
+            }
+        }
+        else
+        {
+            // End of a pipe or file, a hung-up tty, or a read error.
+            if (n < 0)
+            {
+                perror("eventcat");
+            }
+            break;
+        }
+    }
+
+    eventReorderFlush(&itsReorder, printEventLine, NULL);
+    flushOutput();
+    if (watch >= 0)
+    {
+        close(watch);
+    }
+    return 0;
+}
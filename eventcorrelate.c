@@ -0,0 +1,146 @@
+/*
+* @file eventcorrelate.c
+*
+* Matches EVENT_SEND with EVENT_RECEIVE by message ID and prints latency
+* and loss per route.
+*
+* usage: eventcorrelate [-w windowMicros] [-n capacity] [capture]
+*
+*   capture   a capture file, or a merged one from eventshmcollect.
+*             Standard input if omitted, so it can read a live stream.
+*   -w        how long a send waits for its receive (default 1000000 us)
+*   -n        how many messages can be in flight at once (default 65536)
+*
+* For each route it prints the messages matched, the median, 99th
+* percentile and maximum latency in microseconds, and the duplicates and
+* reordered messages.  For each sending source it prints the messages
+* sent, lost, resent and evicted for lack of room.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "EventCorrelate.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: eventcorrelate [-w windowMicros] [-n capacity] [capture]\n");
+    exit(2);
+}
+
+static const char* nameOf(EventSource source)
+{
+    const char* name = eventSourceName(source);
+
+    return name ? name : "?";
+}
+
+static void printReport(const EventCorrelator* corr)
+{
+    printf("%-12s %-12s %10s %8s %8s %8s %8s %8s\n", "from", "to", "matched", "p50", "p99", "max", "dup", "reorder");
+    for (int from = 0; from < EVENT_SOURCE_COUNT; from++)
+    {
+        for (int to = 0; to < EVENT_SOURCE_COUNT; to++)
+        {
+            const EventRouteStats* route = &corr->routes[from][to];
+
+            if (route->matched == 0 && route->duplicates == 0)
+            {
+                continue;
+            }
+            printf("%-12s %-12s %10llu %8u %8u %8u %8llu %8llu\n",
+                nameOf((EventSource)from), nameOf((EventSource)to),
+                (unsigned long long)route->matched,
+                eventRouteLatencyPercentile(route, 0.5),
+                eventRouteLatencyPercentile(route, 0.99),
+                route->latencyMax,
+                (unsigned long long)route->duplicates,
+                (unsigned long long)route->reordered);
+        }
+    }
+
+    printf("\n%-12s %10s %10s %10s %10s\n", "sender", "sent", "lost", "resent", "evicted");
+    for (int from = 0; from < EVENT_SOURCE_COUNT; from++)
+    {
+        const EventSenderStats* sender = &corr->senders[from];
+
+        if (sender->sent == 0)
+        {
+            continue;
+        }
+        printf("%-12s %10llu %10llu %10llu %10llu\n", nameOf((EventSource)from),
+            (unsigned long long)sender->sent, (unsigned long long)sender->lost,
+            (unsigned long long)sender->resent, (unsigned long long)sender->evicted);
+    }
+    printf("\n%llu receives matched no send\n", (unsigned long long)corr->orphans);
+}
+
+int main(int argc, char** argv)
+{
+    static EventStream stream;
+    static EventCorrelator corr;
+    uint32_t window = 1000000;
+    uint32_t capacity = 65536;
+    FILE* in = stdin;
+    int arg = 1;
+
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (argv[arg][1] == 'w' && !argv[arg][2])
+        {
+            window = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+        }
+        else if (argv[arg][1] == 'n' && !argv[arg][2])
+        {
+            capacity = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (arg < argc)
+    {
+        if (argv[arg][0] == '-' || arg + 1 < argc)
+        {
+            usage();
+        }
+        in = fopen(argv[arg], "rb");
+        if (!in)
+        {
+            perror(argv[arg]);
+            return 1;
+        }
+    }
+
+    if (!eventCorrelatorInit(&corr, capacity, window))
+    {
+        fprintf(stderr, "eventcorrelate: out of memory\n");
+        return 1;
+    }
+    eventStreamInit(&stream);
+    for (;;)
+    {
+        EventFrameView view;
+        size_t room;
+        char* space = eventStreamSpace(&stream, &room);
+        size_t n = fread(space, 1, room, in);
+
+        if (n == 0)
+        {
+            break;
+        }
+        eventStreamCommit(&stream, n);
+        while (eventStreamNext(&stream, &view))
+        {
+            EventData event = eventFrameEvent(&view);
+
+            eventCorrelatorAdd(&corr, &event);
+        }
+    }
+    eventCorrelatorFinish(&corr);
+
+    printReport(&corr);
+    eventCorrelatorFree(&corr);
+    fclose(in);
+    return 0;
+}
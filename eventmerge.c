@@ -0,0 +1,154 @@
+/*
+* @file eventmerge.c
+*
+* Merges the captures of several boards into one listing in corrected
+* time order.
+*
+* usage: eventmerge [-y source,type] capture[@offset[,driftPpm]]...
+*
+*   capture   a capture file
+*   offset    microseconds to add to this capture's unwrapped time
+*   driftPpm  how fast this capture's clock runs slow, in parts per million
+*   -y        estimate the offset and drift of every capture that doesn't
+*             give them from the given sync event, which every board logs
+*             at the same moment.  Times are then those of the first capture.
+*
+* Each line is the index of the capture the event came from, its corrected
+* time in microseconds and the event as eventcat prints it.  Each capture
+* is read a buffer at a time, twice when estimating, so memory use doesn't
+* depend on the size of the captures.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EventMerge.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: eventmerge [-y source,type] capture[@offset[,driftPpm]]...\n");
+    exit(2);
+}
+
+int main(int argc, char** argv)
+{
+    static char out[64 * 1024];
+    EventMerge merge;
+    EventMergeEvent ev;
+    const char** paths;
+    int64_t* offsets;
+    double* drifts;
+    bool* given;
+    bool estimate = false;
+    long syncSource = 0;
+    long syncType = 0;
+    int first = 1;
+    int count;
+
+    if (argc > 2 && strcmp(argv[1], "-y") == 0)
+    {
+        char* end;
+
+        syncSource = strtol(argv[2], &end, 0);
+        if (*end != ',')
+        {
+            usage();
+        }
+        syncType = strtol(end + 1, &end, 0);
+        if (*end || syncSource < 0 || syncSource >= EVENT_SOURCE_COUNT || syncType < 0 || syncType >= EVENT_TYPE_COUNT)
+        {
+            usage();
+        }
+        estimate = true;
+        first = 3;
+    }
+    count = argc - first;
+    if (count < 1)
+    {
+        usage();
+    }
+
+    paths = calloc((size_t)count, sizeof(*paths));
+    offsets = calloc((size_t)count, sizeof(*offsets));
+    drifts = calloc((size_t)count, sizeof(*drifts));
+    given = calloc((size_t)count, sizeof(*given));
+    if (!paths || !offsets || !drifts || !given || !eventMergeInit(&merge, count))
+    {
+        fprintf(stderr, "eventmerge: out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        char* arg = argv[first + i];
+        char* at = strrchr(arg, '@');
+
+        paths[i] = arg;
+        if (at)
+        {
+            char* end;
+
+            *at = 0;
+            offsets[i] = strtoll(at + 1, &end, 0);
+            if (*end == ',')
+            {
+                drifts[i] = strtod(end + 1, &end);
+            }
+            if (*end)
+            {
+                usage();
+            }
+            given[i] = true;
+        }
+    }
+
+    if (estimate)
+    {
+        int64_t* estOffsets = calloc((size_t)count, sizeof(*estOffsets));
+        double* estDrifts = calloc((size_t)count, sizeof(*estDrifts));
+
+        if (!estOffsets || !estDrifts
+            || !eventMergeEstimate(paths, count, (EventSource)syncSource, (EventType)syncType, estOffsets, estDrifts))
+        {
+            fprintf(stderr, "eventmerge: can't find sync event %ld,%ld in every capture\n", syncSource, syncType);
+            return 1;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (!given[i])
+            {
+                offsets[i] = estOffsets[i];
+                drifts[i] = estDrifts[i];
+            }
+            fprintf(stderr, "%d %s offset %lld drift %.3f ppm\n", i, paths[i], (long long)offsets[i], drifts[i]);
+        }
+        free(estOffsets);
+        free(estDrifts);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!eventMergeOpen(&merge, i, paths[i], offsets[i], drifts[i]))
+        {
+            perror(paths[i]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    while (eventMergeNext(&merge, &ev))
+    {
+        char line[EVENT_FORMAT_MAX];
+
+        eventFormat(&ev.event, line, sizeof(line));
+        printf("%d %lld %s", ev.origin, (long long)ev.time, line);
+    }
+    fflush(stdout);
+
+    eventMergeClose(&merge);
+    free(paths);
+    free(offsets);
+    free(drifts);
+    free(given);
+    return 0;
+}
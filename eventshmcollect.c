@@ -0,0 +1,101 @@
+/*
+* @file eventshmcollect.c
+*
+* Merges the EventLog shared-memory rings of several processes into one
+* capture, in timestamp order.
+*
+* usage: eventshmcollect [-o capture] [-h holdMicros] name...
+*
+*   name      a ring created with eventShmProducerOpen(), such as /evlog-nav
+*   -o        capture file to write (default standard output)
+*   -h        how long to hold frames back waiting for a quiet ring
+*             (default 10000 us)
+*
+* Runs until every producer has closed or exited and its ring is drained,
+* or until interrupted.  It sleeps for a millisecond whenever a poll
+* finds nothing to pass on.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "EventShm.h"
+
+static volatile sig_atomic_t itsStop;
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    itsStop = 1;
+}
+
+static void writeFrame(void* context, const char* buf, int len)
+{
+    fwrite(buf, 1, (size_t)len, (FILE*)context);
+}
+
+int main(int argc, char** argv)
+{
+    static EventShmCollector collector;
+    struct timespec idle = { 0, 1000000 };
+    uint32_t hold = 10000;
+    FILE* out = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:h:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            out = fopen(optarg, "wb");
+            if (!out)
+            {
+                perror(optarg);
+                return 1;
+            }
+            break;
+        case 'h':
+            hold = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: eventshmcollect [-o capture] [-h holdMicros] name...\n");
+            return 2;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: eventshmcollect [-o capture] [-h holdMicros] name...\n");
+        return 2;
+    }
+
+    eventShmCollectorInit(&collector);
+    for (int i = optind; i < argc; i++)
+    {
+        if (!eventShmCollectorAdd(&collector, argv[i]))
+        {
+            fprintf(stderr, "eventshmcollect: can't map ring %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    while (!itsStop && !eventShmCollectorDone(&collector))
+    {
+        if (eventShmCollectorPoll(&collector, hold, writeFrame, out) == 0)
+        {
+            fflush(out);
+            nanosleep(&idle, NULL);
+        }
+    }
+    // Pass on whatever is left without waiting for quiet rings.
+    eventShmCollectorPoll(&collector, 0, writeFrame, out);
+
+    eventShmCollectorClose(&collector);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*
+* @file eventtrace.c
+*
+* Converts a capture to Chrome trace JSON, for chrome://tracing, Perfetto
+* or speedscope.
+*
+* usage: eventtrace [-p pid] [capture] > trace.json
+*
+*   capture   a capture file.  Standard input if omitted.
+*   -p        process ID to put the events under (default 1), so traces
+*             from several boards can be loaded side by side
+*
+* Each source is a track of its own.  EVENT_START and EVENT_STOP become
+* the beginning and end of a span, which nest; the span is named by the
+* START payload if it has one and by the source otherwise.  Spans open at
+* the end of the capture are closed at its last timestamp, and a STOP with
+* no START, from a capture that began mid-span, is dropped.  Every other
+* event is an instant with its type as the name and its payload as an
+* argument.  Timestamps are unwrapped to microseconds since the first
+* event.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EventLog.h"
+
+#define MAX_DEPTH 255
+
+static int itsPid = 1;
+static bool itsFirst = true;
+static uint8_t itsDepth[EVENT_SOURCE_COUNT];
+static bool itsSeen[EVENT_SOURCE_COUNT];
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: eventtrace [-p pid] [capture]\n");
+    exit(2);
+}
+
+// Payload as a JSON value.  Returns false if there is none.
+static bool printPayload(const EventData* event)
+{
+    switch (event->dataType)
+    {
+    case EVENT_DATA_BOOL:   printf("%s", event->data.boolean ? "true" : "false"); return true;
+    case EVENT_DATA_INT8:   printf("%d", event->data.s8); return true;
+    case EVENT_DATA_UINT8:  printf("%u", event->data.u8); return true;
+    case EVENT_DATA_INT16:  printf("%d", event->data.s16); return true;
+    case EVENT_DATA_UINT16: printf("%u", event->data.u16); return true;
+    case EVENT_DATA_INT32:  printf("%ld", (long)event->data.s32); return true;
+    case EVENT_DATA_UINT32: printf("%lu", (unsigned long)event->data.u32); return true;
+    case EVENT_DATA_FLOAT:  printf("%.9g", event->data.f32); return true;
+    case EVENT_DATA_STRING:
+        putchar('"');
+        for (int i = 0; i < 4 && event->data.str[i]; i++)
+        {
+            unsigned char c = (unsigned char)event->data.str[i];
+
+            if (c == '"' || c == '\\')
+            {
+                printf("\\%c", c);
+            }
+            else if (c < 0x20 || c >= 0x7F)
+            {
+                printf("\\u%04x", c);
+            }
+            else
+            {
+                putchar(c);
+            }
+        }
+        putchar('"');
+        return true;
+    default:
+        return false;
+    }
+}
+
+static const char* nameOf(const char* name)
+{
+    return name ? name : "?";
+}
+
+static void beginRecord(const char* phase, int source, int64_t time)
+{
+    printf("%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%lld", itsFirst ? "" : ",", phase, itsPid, source, (long long)time);
+    itsFirst = false;
+}
+
+static void convert(const EventData* event, int64_t time)
+{
+    int source = event->sourceID;
+
+    if (source >= EVENT_SOURCE_COUNT)
+    {
+        return;
+    }
+    if (!itsSeen[source])
+    {
+        itsSeen[source] = true;
+        printf("%s\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+            itsFirst ? "" : ",", itsPid, source, nameOf(eventSourceName((EventSource)source)));
+        itsFirst = false;
+    }
+
+    if (event->eventID == EVENT_START && itsDepth[source] < MAX_DEPTH)
+    {
+        itsDepth[source]++;
+        beginRecord("B", source, time);
+        printf(",\"name\":");
+        if (event->dataType == EVENT_DATA_NONE)
+        {
+            printf("\"%s\"", nameOf(eventSourceName((EventSource)source)));
+        }
+        else if (event->dataType == EVENT_DATA_STRING)
+        {
+            printPayload(event);
+        }
+        else
+        {
+            putchar('"');
+            printPayload(event);
+            putchar('"');
+        }
+        printf("}");
+    }
+    else if (event->eventID == EVENT_STOP)
+    {
+        if (itsDepth[source] == 0)
+        {
+            return;
+        }
+        itsDepth[source]--;
+        beginRecord("E", source, time);
+        if (event->dataType != EVENT_DATA_NONE)
+        {
+            printf(",\"args\":{\"payload\":");
+            printPayload(event);
+            printf("}");
+        }
+        printf("}");
+    }
+    else
+    {
+        beginRecord("i", source, time);
+        printf(",\"s\":\"t\",\"name\":\"%s\",\"args\":{\"level\":\"%s\"",
+            nameOf(eventTypeName(event->eventID)), nameOf(eventLevelName(event->level)));
+        if (event->dataType != EVENT_DATA_NONE)
+        {
+            printf(",\"payload\":");
+            printPayload(event);
+        }
+        printf("}}");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    static EventStream stream;
+    static char out[64 * 1024];
+    FILE* in = stdin;
+    bool started = false;
+    uint32_t lastRaw = 0;
+    int64_t time = 0;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-p") == 0)
+    {
+        itsPid = atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (arg < argc)
+    {
+        if (argv[arg][0] == '-' || arg + 1 < argc)
+        {
+            usage();
+        }
+        in = fopen(argv[arg], "rb");
+        if (!in)
+        {
+            perror(argv[arg]);
+            return 1;
+        }
+    }
+
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    printf("{\"traceEvents\":[");
+    eventStreamInit(&stream);
+    for (;;)
+    {
+        EventFrameView view;
+        size_t room;
+        char* space = eventStreamSpace(&stream, &room);
+        size_t n = fread(space, 1, room, in);
+
+        if (n == 0)
+        {
+            break;
+        }
+        eventStreamCommit(&stream, n);
+        while (eventStreamNext(&stream, &view))
+        {
+            EventData event = eventFrameEvent(&view);
+            uint32_t raw = event.timestamp & EVENT_TIMESTAMP_MASK;
+            uint32_t delta = (raw - lastRaw) & EVENT_TIMESTAMP_MASK;
+
+            if (!event.valid)
+            {
+                continue;
+            }
+            // Small steps back are jitter between merged sources, not a
+            // rollover; they don't move the clock backwards.
+            if (!started || delta <= (EVENT_TIMESTAMP_MASK >> 1))
+            {
+                time += started ? delta : 0;
+                lastRaw = raw;
+                started = true;
+            }
+            convert(&event, time);
+        }
+    }
+
+    for (int source = 0; source < EVENT_SOURCE_COUNT; source++)
+    {
+        while (itsDepth[source] > 0)
+        {
+            itsDepth[source]--;
+            beginRecord("E", source, time);
+            printf("}");
+        }
+    }
+    printf("\n]}\n");
+    fflush(stdout);
+    fclose(in);
+    return 0;
+}
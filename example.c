@@ -1,7 +1,20 @@
+#define _DEFAULT_SOURCE
+
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include "EventCapture.h"
+#include "EventClock.h"
+#include "EventLog.h"
 #include "UnitTest.h"
+#include "UnitTestBench.h"
+#include "UnitTestRunner.h"
 
-void testBasics(void)
+TEST(testBasics)
 {
 	ASSERT_TRUE(0);
 	ASSERT_TRUE(1);
@@ -9,7 +22,7 @@ void testBasics(void)
 	ASSERT_FALSE(1);
 }
 
-void testIntegers(void)
+TEST(testIntegers)
 {
 	int8_t s8zero = 0;
 	int8_t s8one = 1;
@@ -110,7 +123,7 @@ void testIntegers(void)
 
 }
 
-void testFloats(void)
+TEST(testFloats)
 {
 	float f32zero = 0.0;
 	float f32two = 2.0;
@@ -147,7 +160,7 @@ void testFloats(void)
 
 }
 
-void testStrings(void)
+TEST(testStrings)
 {
 	char strFoo[] = "FOO";
 	char strBar[] = "BAR";
@@ -158,7 +171,7 @@ void testStrings(void)
 	ASSERT_STR_NOT_EQUAL(strFoo, strBar);
 }
 
-void testMemory(void)
+TEST(testMemory)
 {
 	uint16_t bufFoo[] = {0, 1, 2};
 	uint16_t bufBar[] = {4, 5, 6};
@@ -169,8 +182,35 @@ void testMemory(void)
 	ASSERT_MEM_NOT_EQUAL(6, bufFoo, bufBar);
 }
 
+#define RUN_TESTS 300
+
+static atomic_int itsRunCount;
+
+static void countRun(void)
+{
+	atomic_fetch_add(&itsRunCount, 1);
+}
+
+// A serial test holds up the commits of everything after it until the
+// workers are done, far more than the runner lets wait otherwise; the
+// run must still finish.
+TEST(testRunSerialFirst)
+{
+	static UnitTestCase tests[RUN_TESTS];
+
+	for (int i = 0; i < RUN_TESTS; i++)
+	{
+		tests[i].name = "countRun";
+		tests[i].func = countRun;
+		tests[i].serial = i == 0;
+	}
+	atomic_store(&itsRunCount, 0);
+	unitTestRun(tests, RUN_TESTS, 2, NULL, NULL);
+	ASSERT_S32_EQUAL(atomic_load(&itsRunCount), RUN_TESTS);
+}
+
 #if 0
-void testPointers(void)
+TEST(testPointers)
 {
 	int tmpFoo;
 	int tmpBar;
@@ -187,25 +227,392 @@ void testPointers(void)
 }
 #endif
 
-typedef void(*TestFunc)(void);
+BENCHMARK(benchSnprintf)
+{
+	char buf[16];
+	int value = 42;
+
+	BENCHMARK_LOOP(bench)
+	{
+		DO_NOT_OPTIMIZE(value);
+		snprintf(buf, sizeof(buf), "%d", value);
+		DO_NOT_OPTIMIZE(buf);
+	}
+}
+
+// Fails if copying gets 30% slower than the baseline for this machine.
+BENCHMARK_BASELINE(benchMemcpy, 0.30)
+{
+	uint8_t from[256] = { 0 };
+	uint8_t to[256];
+
+	BENCHMARK_LOOP(bench)
+	{
+		memcpy(to, from, sizeof(to));
+		DO_NOT_OPTIMIZE(to);
+	}
+}
+
+#define ASSERT_BENCH_DRAIN 1024
+#define ASSERT_BENCH_THREADS 3
+// Results the shared-log producers may get ahead of the reader.
+#define ASSERT_BENCH_BACKLOG 4096
+
+// A passing assertion, as a test makes them in a loop.  Every so often
+// the results so far are handed to reporter, or dropped, so the
+// benchmark's memory stays flat and the pass count isn't inflated.
+static inline void assertAndDrain(UnitTestCapture* capture, uint32_t* count, UnitTestReporter reporter,
+	void* context)
+{
+	int32_t value = 42;
+
+	DO_NOT_OPTIMIZE(value);
+	ASSERT_S32_EQUAL(value, 42);
+	if (++*count % ASSERT_BENCH_DRAIN == 0)
+	{
+		unitTestCaptureDrain(capture, reporter, context);
+	}
+}
+
+static void endCapture(UnitTestCapture* capture)
+{
+	unitTestCaptureEnd();
+	unitTestCaptureDrain(capture, NULL, NULL);
+	unitTestCaptureCommit(capture);
+}
+
+static void readResult(void* context, const UnitTestOutput* entry)
+{
+	size_t* chars = context;
+
+	*chars += strlen(entry->msg);
+}
+
+// What a passing assertion costs the test that makes it: its operands are
+// stored, and the message isn't formatted.
+BENCHMARK(benchAssertPass)
+{
+	UnitTestCapture* capture = unitTestCaptureBegin();
+	uint32_t count = 0;
+
+	BENCHMARK_LOOP(bench)
+	{
+		assertAndDrain(capture, &count, NULL, NULL);
+	}
+	endCapture(capture);
+}
+
+// As benchAssertPass, with each result also read back and its message
+// formatted, as unitTestGetEntry() does.  The difference between the two
+// is the cost of reading.
+BENCHMARK(benchAssertRead)
+{
+	UnitTestCapture* capture = unitTestCaptureBegin();
+	uint32_t count = 0;
+	size_t chars = 0;
+
+	BENCHMARK_LOOP(bench)
+	{
+		assertAndDrain(capture, &count, readResult, &chars);
+	}
+	endCapture(capture);
+	DO_NOT_OPTIMIZE(chars);
+}
+
+static atomic_bool itsContending;
+
+static int assertUntilStopped(void* arg)
+{
+	UnitTestCapture* capture = unitTestCaptureBegin();
+	uint32_t count = 0;
+
+	(void)arg;
+	while (atomic_load_explicit(&itsContending, memory_order_relaxed))
+	{
+		assertAndDrain(capture, &count, NULL, NULL);
+	}
+	endCapture(capture);
+	return 0;
+}
+
+// Assertions while ASSERT_BENCH_THREADS other threads assert flat out,
+// each into a capture of its own as tests on the worker pool do.  With
+// fewer cores than threads, the time the others run shows in the figure.
+BENCHMARK(benchAssertContended)
+{
+	thrd_t threads[ASSERT_BENCH_THREADS];
+	int started = 0;
+	UnitTestCapture* capture;
+	uint32_t count = 0;
+
+	atomic_store(&itsContending, true);
+	for (int i = 0; i < ASSERT_BENCH_THREADS; i++)
+	{
+		if (thrd_create(&threads[started], assertUntilStopped, NULL) == thrd_success)
+		{
+			started++;
+		}
+	}
+
+	capture = unitTestCaptureBegin();
+	BENCHMARK_LOOP(bench)
+	{
+		assertAndDrain(capture, &count, NULL, NULL);
+	}
+	endCapture(capture);
+
+	atomic_store(&itsContending, false);
+	for (int i = 0; i < started; i++)
+	{
+		thrd_join(threads[i], NULL);
+	}
+}
 
-TestFunc testList[] = {
-	testBasics,
-	testIntegers,
-	testFloats,
-	testStrings,
-	testMemory,
-//	testPointers
-};
+static atomic_uint_fast64_t itsProduced;
+static atomic_uint_fast64_t itsConsumed;
 
-#define N_TESTS (sizeof(testList)/sizeof(testList[0]))
+// Asserts with no capture, so into the shared log, as fast as the reader
+// keeps up.
+static int assertToLog(void* arg)
+{
+	(void)arg;
+	while (atomic_load_explicit(&itsContending, memory_order_relaxed))
+	{
+		int32_t value = 42;
+
+		if (atomic_load_explicit(&itsProduced, memory_order_relaxed)
+			- atomic_load_explicit(&itsConsumed, memory_order_relaxed) > ASSERT_BENCH_BACKLOG)
+		{
+			thrd_yield();
+			continue;
+		}
+		DO_NOT_OPTIMIZE(value);
+		ASSERT_S32_EQUAL(value, 42);
+		atomic_fetch_add_explicit(&itsProduced, 1, memory_order_relaxed);
+	}
+	return 0;
+}
 
-void runTests(void)
+// Reads results off the shared log with unitTestGetEntry() while as
+// many threads as producers assert into it, one result per iteration.
+// What's read is taken back off the pass count.
+static void readSharedLog(UnitTestBench* bench, int producers)
 {
-	for (int i = 0; i < N_TESTS; i++)
-		(testList[i])();
+	thrd_t threads[ASSERT_BENCH_THREADS];
+	UnitTestOutput output;
+	int started = 0;
+	uint64_t read = 0;
+
+	atomic_store(&itsProduced, 0);
+	atomic_store(&itsConsumed, 0);
+	atomic_store(&itsContending, true);
+	for (int i = 0; i < producers; i++)
+	{
+		if (thrd_create(&threads[started], assertToLog, NULL) == thrd_success)
+		{
+			started++;
+		}
+	}
+
+	BENCHMARK_LOOP(bench)
+	{
+		while (!unitTestGetEntry(&output))
+		{
+			thrd_yield();
+		}
+		atomic_store_explicit(&itsConsumed, ++read, memory_order_relaxed);
+	}
+
+	atomic_store(&itsContending, false);
+	for (int i = 0; i < started; i++)
+	{
+		thrd_join(threads[i], NULL);
+	}
+	while (unitTestGetEntry(&output))
+	{
+		read++;
+	}
+	unitTestAddCounts(-(int32_t)read, 0);
 }
 
+// A result through the shared log from one producer thread to the reader.
+BENCHMARK(benchAssertShared)
+{
+	readSharedLog(bench, 1);
+}
+
+// As benchAssertShared, with ASSERT_BENCH_THREADS producers claiming
+// entries of the log at once.
+BENCHMARK(benchAssertSharedContended)
+{
+	readSharedLog(bench, ASSERT_BENCH_THREADS);
+}
+
+#define SCAN_CAPTURE_PATH "unittest.capture"
+#define SCAN_CAPTURE_EVENTS 65536
+
+static void writeToFile(void* context, const char* buf, int len)
+{
+	fwrite(buf, 1, (size_t)len, context);
+}
+
+static uint32_t countClock(void* context)
+{
+	uint32_t* time = context;
+
+	return (*time += 7);
+}
+
+// Writes a capture of mostly INFO, with every 16th event an ERROR and
+// payloads running through the bytes that need escaping.
+static bool writeScanCapture(void)
+{
+	FILE* file = fopen(SCAN_CAPTURE_PATH, "wb");
+	EventLogger logger;
+	uint32_t time = 0;
+
+	if (!file)
+	{
+		return false;
+	}
+	eventLoggerInit(&logger);
+	eventLoggerSetSink(&logger, writeToFile, file);
+	eventLoggerSetClock(&logger, countClock, &time);
+	for (uint32_t i = 0; i < SCAN_CAPTURE_EVENTS; i++)
+	{
+		EventLevel level = (i % 16 == 0) ? EVENT_ERROR : (i % 4 == 0) ? EVENT_WARNING : EVENT_INFO;
+
+		eventLogU32(&logger, level, EVENT_SOURCE_MAIN, EVENT_GENERIC, i);
+	}
+	return fclose(file) == 0;
+}
+
+// Counting the ERRORs in a capture the way the tools first did: read the
+// file and decode every frame with eventUnpackFrame().  One frame per
+// iteration, starting over at the end.
+BENCHMARK(benchCountErrorsUnpack)
+{
+	FILE* file;
+	char* data = NULL;
+	long size = 0;
+	long pos = 0;
+	uint32_t errors = 0;
+
+	if (!writeScanCapture() || !(file = fopen(SCAN_CAPTURE_PATH, "rb")))
+	{
+		return;
+	}
+	if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && (data = malloc((size_t)size)))
+	{
+		rewind(file);
+		size = (long)fread(data, 1, (size_t)size, file);
+	}
+	fclose(file);
+	remove(SCAN_CAPTURE_PATH);
+	if (!data)
+	{
+		return;
+	}
+
+	BENCHMARK_LOOP(bench)
+	{
+		EventData event = eventUnpackFrame(data + pos, (int)(size - pos));
+
+		errors += event.valid && event.level == EVENT_ERROR;
+		pos += event.frameSize;
+		if (pos >= size || event.frameSize == 0)
+		{
+			pos = 0;
+		}
+	}
+	DO_NOT_OPTIMIZE(errors);
+	free(data);
+}
+
+// The same count over the mapped capture with the frame iterator, which
+// decodes only the level.
+BENCHMARK(benchCountErrorsView)
+{
+	EventCapture capture;
+	EventFrameIter iter;
+	EventFrameView view;
+	uint32_t errors = 0;
+
+	if (!writeScanCapture() || !eventCaptureOpen(&capture, SCAN_CAPTURE_PATH))
+	{
+		remove(SCAN_CAPTURE_PATH);
+		return;
+	}
+
+	eventFrameIterInit(&iter, capture.data, capture.size);
+	BENCHMARK_LOOP(bench)
+	{
+		if (!eventFrameNext(&iter, &view))
+		{
+			eventFrameIterInit(&iter, capture.data, capture.size);
+			eventFrameNext(&iter, &view);
+		}
+		errors += eventFrameLevel(&view) == EVENT_ERROR;
+	}
+	DO_NOT_OPTIMIZE(errors);
+	eventCaptureClose(&capture);
+	remove(SCAN_CAPTURE_PATH);
+}
+
+static void discardFrame(void* context, const char* buf, int len)
+{
+	(void)context;
+	(void)len;
+	DO_NOT_OPTIMIZE(buf);
+}
+
+// Logs one event per iteration with clock as the logger's clock, to a
+// sink that drops it.
+static void logWithClock(UnitTestBench* bench, EventClockFunc clock)
+{
+	EventLogger logger;
+	uint32_t value = 0;
+
+	eventLoggerInit(&logger);
+	eventLoggerSetSink(&logger, discardFrame, NULL);
+	eventLoggerSetClock(&logger, clock, NULL);
+	BENCHMARK_LOOP(bench)
+	{
+		eventLogU32(&logger, EVENT_INFO, EVENT_SOURCE_MAIN, EVENT_GENERIC, value++);
+	}
+}
+
+// An event timestamped by eventClockMicros(): the calibrated TSC, where
+// eventClockInit() finds an invariant one.
+BENCHMARK(benchEventClockTsc)
+{
+	static bool calibrated;
+
+	if (!calibrated)
+	{
+		eventClockInit();
+		calibrated = true;
+	}
+	logWithClock(bench, eventClockMicrosContext);
+}
+
+#ifndef _WIN32
+static uint32_t gettimeMicros(void* context)
+{
+	struct timespec ts;
+
+	(void)context;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u) & EVENT_TIMESTAMP_MASK;
+}
+
+// The same event timestamped from clock_gettime(), the clock
+// eventClockMicros() falls back to.
+BENCHMARK(benchEventClockGettime)
+{
+	logWithClock(bench, gettimeMicros);
+}
+#endif
 
 #define XSTR(x) STR(x)
 #define STR(x) #x
@@ -228,8 +635,8 @@ void foo(void)
 	printf("%s:%d", __func__, __LINE__);
 }
 
-DECL_RET(int, foo2);
-DEF_RET(int, foo2);
+DECL_RET(foo2, int);
+DEF_RET(foo2, int);
 DECL_COUNT(foo2);
 DEF_COUNT(foo2);
 
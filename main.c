@@ -3,26 +3,295 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "UnitTest.h"
+#include "UnitTestBench.h"
+#include "UnitTestReport.h"
+#include "UnitTestRunner.h"
 
-extern void runTests(void);
+#define MAX_FILTERS 32
 
-int main()
+// Tests listed in each summary, by default.
+#define TOP_TESTS 5
+
+static const UnitTestMetrics* itsMetrics;
+
+static int bySlowest(const void* a, const void* b)
 {
-    printf("%s\n", __func__);
-    runTests();
+    double x = itsMetrics[*(const int*)a].wallSeconds;
+    double y = itsMetrics[*(const int*)b].wallSeconds;
+
+    return (x < y) - (x > y);
+}
+
+static int byMostAllocating(const void* a, const void* b)
+{
+    uint64_t x = itsMetrics[*(const int*)a].allocatedBytes;
+    uint64_t y = itsMetrics[*(const int*)b].allocatedBytes;
+
+    return (x < y) - (x > y);
+}
+
+static void printTop(FILE* out, const char* title, const UnitTestCase* tests, const UnitTestMetrics* metrics,
+    int count, int top, int (*compare)(const void*, const void*))
+{
+    int* order = malloc(sizeof(int) * (count > 0 ? count : 1));
+
+    if (!order)
+    {
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = i;
+    }
+    itsMetrics = metrics;
+    qsort(order, count, sizeof(int), compare);
+
+    fprintf(out, "%s:\n", title);
+    for (int i = 0; i < count && i < top; i++)
+    {
+        const UnitTestMetrics* m = &metrics[order[i]];
+
+        fprintf(out, "  %-24s %9.3f ms wall %9.3f ms cpu %8llu allocs %10llu bytes %+7ld KiB peak RSS\n",
+            tests[order[i]].name, m->wallSeconds * 1e3, m->cpuSeconds * 1e3,
+            (unsigned long long)m->allocations, (unsigned long long)m->allocatedBytes, m->peakRssDeltaKb);
+    }
+    free(order);
+}
+
+static UnitTestReport itsReports[UNIT_TEST_MAX_REPORTS];
+static UnitTestWriter itsWriters[UNIT_TEST_MAX_REPORTS];
+static FILE* itsFiles[UNIT_TEST_MAX_REPORTS];
+static int itsReportCount;
+// Where the summaries go: stderr once a report other than text has stdout,
+// so what it writes there stays well formed.
+static FILE* itsSummary;
+
+// Sets up a report from "format[:path]".  Returns false if the format is
+// unknown or the file won't open.
+static bool addReport(const char* spec)
+{
+    const char* colon = strchr(spec, ':');
+    size_t formatLen = colon ? (size_t)(colon - spec) : strlen(spec);
+    UnitTestReport* report = &itsReports[itsReportCount];
+    UnitTestWriter* writer = &itsWriters[itsReportCount];
+    FILE* file = stdout;
+
+    if (itsReportCount == UNIT_TEST_MAX_REPORTS)
+    {
+        return false;
+    }
+    if (colon && !(file = fopen(colon + 1, "w")))
+    {
+        return false;
+    }
+    unitTestWriterInit(writer, file);
+    if (formatLen == 4 && strncmp(spec, "text", 4) == 0)
+        unitTestReportText(report, writer);
+    else if (formatLen == 3 && strncmp(spec, "tap", 3) == 0)
+        unitTestReportTap(report, writer);
+    else if (formatLen == 5 && strncmp(spec, "junit", 5) == 0)
+        unitTestReportJUnit(report, writer);
+    else if (formatLen == 4 && strncmp(spec, "json", 4) == 0)
+        unitTestReportJsonLines(report, writer);
+    else
+    {
+        if (file != stdout)
+            fclose(file);
+        return false;
+    }
+    if (file == stdout && !(formatLen == 4 && strncmp(spec, "text", 4) == 0))
+    {
+        itsSummary = stderr;
+    }
+    itsFiles[itsReportCount++] = file;
+    return unitTestAddReport(report);
+}
 
-    UnitTestOutput output = { 0 };
-    while (unitTestGetEntry(&output))
+static void usage(const char* program)
+{
+    printf("usage: %s [options] [filter...]\n"
+        "  filter        glob with * and ?; a leading - excludes what it matches\n"
+        "  --list        list the selected tests instead of running them\n"
+        "  --shard=i/n   run the i'th of n slices of the tests, counting from 0\n"
+        "  --shuffle     run the tests in random order\n"
+        "  --seed=n      seed for --shuffle, to repeat an order\n"
+        "  --jobs=n      threads or processes to run on; default one per core\n"
+        "  --baselines=f file of benchmark baselines; default unittest.baselines\n"
+        "  --update-baselines  record the benchmarks' figures as their baselines\n"
+        "  --top=n       tests to list as slowest and most allocating; default 5\n"
+        "  --report=f[:path]  stream results as text, tap, junit or json lines\n"
+        "                to path, or stdout; may be given more than once\n"
+        "                with other than text on stdout, summaries go to stderr\n"
+#ifndef _WIN32
+        "  --isolate     run each test in a child process\n"
+        "  --timeout=s   with --isolate, kill tests that run longer\n"
+#endif
+        , program);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filters[MAX_FILTERS];
+    UnitTestSelection selection = { 0 };
+    UnitTestRunStats stats;
+    const UnitTestCase* tests;
+    UnitTestCase* selected;
+    UnitTestMetrics* metrics;
+    bool list = false;
+    bool isolate = false;
+    bool seeded = false;
+    bool updateBaselines = false;
+    const char* baselines = "unittest.baselines";
+    int jobs = 0;
+    int top = TOP_TESTS;
+    double timeout = 0.0;
+    int count;
+
+    selection.filters = filters;
+    itsSummary = stdout;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--list") == 0)
+        {
+            list = true;
+        }
+        else if (strncmp(arg, "--shard=", 8) == 0)
+        {
+            if (sscanf(arg + 8, "%d/%d", &selection.shard, &selection.shards) != 2
+                || selection.shards < 1 || selection.shard < 0 || selection.shard >= selection.shards)
+            {
+                fprintf(stderr, "bad shard %s\n", arg + 8);
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--shuffle") == 0)
+        {
+            selection.shuffle = true;
+        }
+        else if (strncmp(arg, "--seed=", 7) == 0)
+        {
+            selection.seed = strtoull(arg + 7, NULL, 0);
+            seeded = true;
+        }
+        else if (strncmp(arg, "--jobs=", 7) == 0)
+        {
+            jobs = atoi(arg + 7);
+        }
+        else if (strncmp(arg, "--baselines=", 12) == 0)
+        {
+            baselines = arg + 12;
+        }
+        else if (strcmp(arg, "--update-baselines") == 0)
+        {
+            updateBaselines = true;
+        }
+        else if (strncmp(arg, "--top=", 6) == 0)
+        {
+            top = atoi(arg + 6);
+        }
+        else if (strncmp(arg, "--report=", 9) == 0)
+        {
+            if (!addReport(arg + 9))
+            {
+                fprintf(stderr, "bad report %s\n", arg + 9);
+                return 2;
+            }
+        }
+#ifndef _WIN32
+        else if (strcmp(arg, "--isolate") == 0)
+        {
+            isolate = true;
+        }
+        else if (strncmp(arg, "--timeout=", 10) == 0)
+        {
+            timeout = atof(arg + 10);
+        }
+#endif
+        else if (arg[0] == '-' && arg[1] == '-')
+        {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? 0 : 2;
+        }
+        else if (selection.filterCount < MAX_FILTERS)
+        {
+            filters[selection.filterCount++] = arg;
+        }
+    }
+
+    if (itsReportCount == 0)
+    {
+        addReport("text");
+    }
+    unitTestBaselineSetFile(baselines, updateBaselines);
+    if (selection.shuffle && !seeded)
+    {
+        selection.seed = (uint64_t)time(NULL);
+    }
+
+    tests = unitTestRegistered(&count);
+    selected = malloc(sizeof(UnitTestCase) * (count > 0 ? count : 1));
+    metrics = malloc(sizeof(UnitTestMetrics) * (count > 0 ? count : 1));
+    if (!selected || !metrics)
+    {
+        return 2;
+    }
+    count = unitTestSelect(tests, count, &selection, selected);
+
+    if (list)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            printf("%s%s\n", selected[i].name, selected[i].serial ? " (serial)" : "");
+        }
+        free(selected);
+        free(metrics);
+        return 0;
+    }
+
+    if (selection.shuffle)
+    {
+        fprintf(itsSummary, "shuffled with --seed=%llu\n", (unsigned long long)selection.seed);
+    }
+#ifndef _WIN32
+    if (isolate)
+    {
+        unitTestRunIsolated(selected, count, jobs, timeout, &stats, metrics);
+    }
+    else
+#endif
+    {
+        unitTestRun(selected, count, jobs, &stats, metrics);
+    }
+
+    for (int r = 0; r < itsReportCount; r++)
+    {
+        if (itsFiles[r] != stdout)
+        {
+            fclose(itsFiles[r]);
+        }
+    }
+
+    fprintf(itsSummary, "%d tests on %d workers: %.3f s, %.3f s run one by one, speedup %.2fx\n",
+        stats.tests, stats.workers, stats.wallSeconds, stats.serialSeconds, unitTestSpeedup(&stats));
+    if (stats.crashed || stats.timedOut)
+    {
+        fprintf(itsSummary, "%d crashed, %d timed out\n", stats.crashed, stats.timedOut);
+    }
+    if (top > 0 && count > 0)
     {
-        if (output.result == UNIT_TEST_PASS)
-            printf("[PASS]");
-        else
-            printf("[FAIL]");
-        printf(" %s:%d %s\n", output.name, output.line, output.msg);
+        printTop(itsSummary, "slowest tests", selected, metrics, count, top, bySlowest);
+        printTop(itsSummary, "most allocating tests", selected, metrics, count, top, byMostAllocating);
     }
+    free(selected);
+    free(metrics);
 
-    return 0;
+    return unitTestFailCount() > 0 ? 1 : 0;
 }
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu